@@ -0,0 +1,412 @@
+#ifndef IDEA_DCH_BATCH_DRIFT_RKF_HH
+#define IDEA_DCH_BATCH_DRIFT_RKF_HH
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "Garfield/Medium.hh"
+#include "Garfield/Sensor.hh"
+
+#include "MagneticFieldMap.hh"
+#include "NearWireDrift.hh"
+#include "PolyaSampler.hh"
+#include "TransportFit.hh"
+#include "TransportTable.hh"
+
+namespace IdeaDch {
+
+/// Drift result of one electron of a batch.
+struct BatchDriftResult {
+  double x = 0., y = 0., z = 0., t = 0.;
+  double gain = 1.;
+  double logGain = 0.;
+  int status = 0;
+  unsigned int nSteps = 0;
+};
+
+/// Runge-Kutta-Fehlberg drift of many electrons in lockstep. The state of
+/// the active electrons is kept in structure-of-arrays form; each stage
+/// evaluates the field for all lanes and then the transport table for all
+/// lanes in one loop. Finished electrons are compacted out after each step.
+/// Like HybridDriftRKF, the drift is completed inside the radius of the
+/// RadialTable by a lookup. With a magnetised transport table, the
+/// velocity includes the E x B terms for the field of a MagneticFieldMap.
+class BatchDriftRKF {
+ public:
+  explicit BatchDriftRKF(Garfield::Sensor* sensor) : m_sensor(sensor) {}
+
+  void SetRadialTable(const RadialTable* table) { m_table = table; }
+  void SetTransportTable(const ElectronTransportTable* table) {
+    m_transport = table;
+  }
+  /// Chebyshev fits of the transport curves, used instead of the table.
+  void SetTransportFit(const TransportFit* fit) { m_transportFit = fit; }
+  /// Transport table with B dependence, used instead of the B = 0 one.
+  void SetMagnetisedTransportTable(const MagnetisedTransportTable* table) {
+    m_magTransport = table;
+  }
+  void SetMagneticField(const MagneticFieldMap* field) { m_bfield = field; }
+  void EnableSignalCalculation(const bool on = true) { m_doSignal = on; }
+  void SetAccuracy(const double eps) { m_accuracy = eps; }
+  void SetMaximumStepSize(const double ds) { m_maxStep = ds; }
+  void SetGainFluctuationsPolya(const double theta, const double mean) {
+    m_polya.Build(theta, 1.);
+    m_meanGain = mean;
+    m_fluctuate = true;
+  }
+
+  /// Add an electron, which represents weight electrons in the signal.
+  void AddElectron(const double x, const double y, const double z,
+                   const double t, const double weight = 1.) {
+    m_start.push_back({x, y, z, t});
+    m_weights.push_back(weight);
+  }
+  void Clear() {
+    m_start.clear();
+    m_weights.clear();
+    m_results.clear();
+  }
+  size_t GetNumberOfElectrons() const { return m_start.size(); }
+  /// Allocate the buffers for batches of up to n electrons, e.g. once a
+  /// worker runs on the NUMA node it should allocate from.
+  void Reserve(const size_t n) {
+    m_start.reserve(n);
+    m_weights.reserve(n);
+    m_results.reserve(n);
+    Resize(n);
+  }
+
+  /// Drift all electrons of the batch.
+  bool Drift() {
+    m_results.assign(m_start.size(), BatchDriftResult());
+    const bool transport =
+        m_magTransport  ? m_magTransport->IsReady()
+        : m_transportFit ? m_transportFit->IsReady()
+                         : m_transport && m_transport->IsReady();
+    if (!m_table || !m_table->IsReady() || !transport) {
+      std::cerr << "BatchDriftRKF::Drift: Tables not set.\n";
+      return false;
+    }
+    const size_t n = m_start.size();
+    Resize(n);
+    m_n = 0;
+    for (size_t i = 0; i < n; ++i) {
+      m_id[m_n] = i;
+      m_x[m_n] = m_start[i][0];
+      m_y[m_n] = m_start[i][1];
+      m_z[m_n] = m_start[i][2];
+      m_t[m_n] = m_start[i][3];
+      m_w[m_n] = m_weights[i];
+      m_lg[m_n] = 0.;
+      m_steps[m_n] = 0;
+      ++m_n;
+    }
+    // Velocity at the starting points.
+    Evaluate(m_n, m_x.data(), m_y.data(), m_z.data(), m_k1x.data(),
+             m_k1y.data(), m_k1z.data(), m_alpha.data(), m_ok.data());
+    for (size_t j = 0; j < m_n; ++j) {
+      const double v = Speed(m_k1x[j], m_k1y[j], m_k1z[j]);
+      m_h[j] = v > 0. ? std::min(m_maxStep, 1.e-3) / v : 1.;
+      m_done[j] = !m_ok[j] ? StatusLeftDriftMedium
+                  : m_table->Inside(m_x[j], m_y[j]) ? StatusHitWire : 0;
+    }
+    Finish();
+    constexpr unsigned int maxSteps = 10000;
+    while (m_n > 0) {
+      StepAll();
+      for (size_t j = 0; j < m_n; ++j) {
+        if (m_done[j] != 0) continue;
+        if (m_table->Inside(m_x[j], m_y[j])) {
+          m_done[j] = StatusHitWire;
+        } else if (m_steps[j] > maxSteps) {
+          m_done[j] = StatusCalculationAbandoned;
+        }
+      }
+      Finish();
+    }
+    if (m_fluctuate) SampleGains();
+    return true;
+  }
+
+  const std::vector<BatchDriftResult>& GetResults() const { return m_results; }
+
+  static constexpr int StatusHitWire = HybridDriftRKF::StatusHitWire;
+  static constexpr int StatusLeftDriftMedium =
+      HybridDriftRKF::StatusLeftDriftMedium;
+  static constexpr int StatusCalculationAbandoned =
+      HybridDriftRKF::StatusCalculationAbandoned;
+
+ private:
+  Garfield::Sensor* m_sensor = nullptr;
+  const RadialTable* m_table = nullptr;
+  const ElectronTransportTable* m_transport = nullptr;
+  const TransportFit* m_transportFit = nullptr;
+  const MagnetisedTransportTable* m_magTransport = nullptr;
+  const MagneticFieldMap* m_bfield = nullptr;
+  bool m_doSignal = true;
+  double m_accuracy = 1.e-6;
+  double m_maxStep = 0.05;
+  bool m_fluctuate = false;
+  PolyaSampler m_polya;
+  double m_meanGain = 0.;
+  std::vector<size_t> m_avalanches;
+  std::vector<double> m_gains;
+
+  std::vector<std::array<double, 4> > m_start;
+  std::vector<double> m_weights;
+  std::vector<BatchDriftResult> m_results;
+
+  // State of the active lanes.
+  size_t m_n = 0;
+  std::vector<size_t> m_id;
+  std::vector<double> m_x, m_y, m_z, m_t, m_w, m_h, m_lg, m_alpha;
+  std::vector<double> m_k1x, m_k1y, m_k1z;
+  std::vector<unsigned int> m_steps;
+  std::vector<int> m_done;
+  // Scratch arrays for the stages.
+  std::vector<double> m_yx, m_yy, m_yz, m_a;
+  std::vector<double> m_kx[5], m_ky[5], m_kz[5];
+  std::vector<double> m_x1, m_y1, m_z1, m_err, m_emag, m_speed;
+  std::vector<double> m_ex, m_ey, m_ez, m_bx, m_by, m_bz;
+  std::vector<char> m_ok, m_ok1;
+
+  static double Speed(const double vx, const double vy, const double vz) {
+    return std::sqrt(vx * vx + vy * vy + vz * vz);
+  }
+
+  void Resize(const size_t n) {
+    for (auto* v : {&m_x, &m_y, &m_z, &m_t, &m_w, &m_h, &m_lg, &m_alpha,
+                    &m_k1x, &m_k1y, &m_k1z, &m_yx, &m_yy, &m_yz, &m_a, &m_x1,
+                    &m_y1, &m_z1, &m_err, &m_emag, &m_speed, &m_ex, &m_ey,
+                    &m_ez, &m_bx, &m_by, &m_bz}) {
+      v->resize(n);
+    }
+    for (int s = 0; s < 5; ++s) {
+      m_kx[s].resize(n);
+      m_ky[s].resize(n);
+      m_kz[s].resize(n);
+    }
+    m_id.resize(n);
+    m_steps.resize(n);
+    m_done.resize(n);
+    m_ok.resize(n);
+    m_ok1.resize(n);
+  }
+
+  /// Drift velocity and alpha - eta at n points.
+  void Evaluate(const size_t n, const double* x, const double* y,
+                const double* z, double* vx, double* vy, double* vz,
+                double* alpha, char* ok) {
+    // Field evaluation: one call per lane.
+    for (size_t j = 0; j < n; ++j) {
+      Garfield::Medium* medium = nullptr;
+      int status = 0;
+      m_sensor->ElectricField(x[j], y[j], z[j], vx[j], vy[j], vz[j], medium,
+                              status);
+      ok[j] = medium && status == 0 && medium->IsDriftable();
+      m_emag[j] = Speed(vx[j], vy[j], vz[j]);
+    }
+    if (m_magTransport) {
+      // Magnetic field and gas table lookup with E x B terms.
+      for (size_t j = 0; j < n; ++j) {
+        m_ex[j] = vx[j];
+        m_ey[j] = vy[j];
+        m_ez[j] = vz[j];
+        if (m_bfield) {
+          m_bfield->Field(x[j], y[j], z[j], m_bx[j], m_by[j], m_bz[j]);
+        } else {
+          m_bx[j] = m_by[j] = m_bz[j] = 0.;
+        }
+      }
+      m_magTransport->Evaluate(n, m_ex.data(), m_ey.data(), m_ez.data(),
+                               m_bx.data(), m_by.data(), m_bz.data(), vx, vy,
+                               vz, alpha);
+      return;
+    }
+    // Gas table lookup (or fit evaluation) for all lanes.
+    if (m_transportFit) {
+      m_transportFit->Evaluate(n, m_emag.data(), m_speed.data(), alpha);
+    } else {
+      m_transport->Evaluate(n, m_emag.data(), m_speed.data(), alpha);
+    }
+    for (size_t j = 0; j < n; ++j) {
+      const double f = m_emag[j] > 0. ? -m_speed[j] / m_emag[j] : 0.;
+      vx[j] *= f;
+      vy[j] *= f;
+      vz[j] *= f;
+    }
+  }
+
+  /// One RKF 4(5) step for all active lanes.
+  void StepAll() {
+    using namespace Rkf45;
+    const size_t n = m_n;
+    // Limit the step length so as not to jump across the near-wire region.
+    for (size_t j = 0; j < n; ++j) {
+      const double v = Speed(m_k1x[j], m_k1y[j], m_k1z[j]);
+      const double dsMax = std::min(
+          m_maxStep, std::max(0.5 * (m_table->Distance(m_x[j], m_y[j]) -
+                                     m_table->GetWireRadius()),
+                              0.1 * m_table->GetRadius()));
+      if (v * m_h[j] > dsMax) m_h[j] = dsMax / v;
+      ++m_steps[j];
+      m_ok1[j] = 1;
+    }
+    // Stage coefficients (rows of the Butcher tableau).
+    const double a[5][5] = {{a21, 0., 0., 0., 0.},
+                            {a31, a32, 0., 0., 0.},
+                            {a41, a42, a43, 0., 0.},
+                            {a51, a52, a53, a54, 0.},
+                            {a61, a62, a63, a64, a65}};
+    for (int s = 0; s < 5; ++s) {
+      for (size_t j = 0; j < n; ++j) {
+        double dx = a[s][0] * m_k1x[j];
+        double dy = a[s][0] * m_k1y[j];
+        double dz = a[s][0] * m_k1z[j];
+        for (int r = 1; r <= s; ++r) {
+          dx += a[s][r] * m_kx[r - 1][j];
+          dy += a[s][r] * m_ky[r - 1][j];
+          dz += a[s][r] * m_kz[r - 1][j];
+        }
+        m_yx[j] = m_x[j] + m_h[j] * dx;
+        m_yy[j] = m_y[j] + m_h[j] * dy;
+        m_yz[j] = m_z[j] + m_h[j] * dz;
+      }
+      Evaluate(n, m_yx.data(), m_yy.data(), m_yz.data(), m_kx[s].data(),
+               m_ky[s].data(), m_kz[s].data(), m_a.data(), m_ok.data());
+      for (size_t j = 0; j < n; ++j) m_ok1[j] &= m_ok[j];
+    }
+    // Combine the stages (k2 .. k6 are m_k[0] .. m_k[4]).
+    for (size_t j = 0; j < n; ++j) {
+      const double h = m_h[j];
+      double err2 = 0.;
+      const double d5x = c1 * m_k1x[j] + c3 * m_kx[1][j] + c4 * m_kx[2][j] +
+                         c5 * m_kx[3][j] + c6 * m_kx[4][j];
+      const double d5y = c1 * m_k1y[j] + c3 * m_ky[1][j] + c4 * m_ky[2][j] +
+                         c5 * m_ky[3][j] + c6 * m_ky[4][j];
+      const double d5z = c1 * m_k1z[j] + c3 * m_kz[1][j] + c4 * m_kz[2][j] +
+                         c5 * m_kz[3][j] + c6 * m_kz[4][j];
+      const double d4x = b1 * m_k1x[j] + b3 * m_kx[1][j] + b4 * m_kx[2][j] +
+                         b5 * m_kx[3][j];
+      const double d4y = b1 * m_k1y[j] + b3 * m_ky[1][j] + b4 * m_ky[2][j] +
+                         b5 * m_ky[3][j];
+      const double d4z = b1 * m_k1z[j] + b3 * m_kz[1][j] + b4 * m_kz[2][j] +
+                         b5 * m_kz[3][j];
+      err2 += (d5x - d4x) * (d5x - d4x) + (d5y - d4y) * (d5y - d4y) +
+              (d5z - d4z) * (d5z - d4z);
+      m_err[j] = h * std::sqrt(err2);
+      m_x1[j] = m_x[j] + h * d5x;
+      m_y1[j] = m_y[j] + h * d5y;
+      m_z1[j] = m_z[j] + h * d5z;
+    }
+    // Velocity at the new points (k1 of the next step).
+    Evaluate(n, m_x1.data(), m_y1.data(), m_z1.data(), m_kx[0].data(),
+             m_ky[0].data(), m_kz[0].data(), m_a.data(), m_ok.data());
+    for (size_t j = 0; j < n; ++j) {
+      const double v = Speed(m_k1x[j], m_k1y[j], m_k1z[j]);
+      const bool tiny = v * m_h[j] < 1.e-8;
+      if (!m_ok1[j] || !m_ok[j]) {
+        // Left the drift medium; retry with a smaller step.
+        m_h[j] *= 0.5;
+        if (tiny) m_done[j] = StatusLeftDriftMedium;
+        continue;
+      }
+      if (m_err[j] > m_accuracy && !tiny) {
+        m_h[j] *= std::max(0.1, 0.9 * std::pow(m_accuracy / m_err[j], 0.2));
+        continue;
+      }
+      const double t1 = m_t[j] + m_h[j];
+      if (m_doSignal) {
+        m_sensor->AddSignal(-m_w[j], m_t[j], t1, m_x[j], m_y[j], m_z[j],
+                            m_x1[j], m_y1[j], m_z1[j], false, true);
+      }
+      const double v1 = Speed(m_kx[0][j], m_ky[0][j], m_kz[0][j]);
+      m_lg[j] += 0.5 * m_h[j] * 0.5 * (v + v1) * (m_alpha[j] + m_a[j]);
+      m_x[j] = m_x1[j];
+      m_y[j] = m_y1[j];
+      m_z[j] = m_z1[j];
+      m_t[j] = t1;
+      m_alpha[j] = m_a[j];
+      m_k1x[j] = m_kx[0][j];
+      m_k1y[j] = m_ky[0][j];
+      m_k1z[j] = m_kz[0][j];
+      const double scale =
+          m_err[j] > 0. ? 0.9 * std::pow(m_accuracy / m_err[j], 0.2) : 4.;
+      m_h[j] *= std::min(4., std::max(0.1, scale));
+      if (v1 <= 0.) m_done[j] = StatusCalculationAbandoned;
+    }
+  }
+
+  /// Sample the gains of all electrons which reached the wire in one go.
+  void SampleGains() {
+    m_avalanches.clear();
+    for (size_t i = 0; i < m_results.size(); ++i) {
+      if (m_results[i].status == StatusHitWire) m_avalanches.push_back(i);
+    }
+    m_gains.resize(m_avalanches.size());
+    m_polya.Sample(m_gains.size(), m_gains.data());
+    for (size_t j = 0; j < m_avalanches.size(); ++j) {
+      auto& res = m_results[m_avalanches[j]];
+      const double mean = m_meanGain > 0. ? m_meanGain : std::exp(res.logGain);
+      res.gain = mean * m_gains[j];
+    }
+  }
+
+  /// Store the results of finished lanes and compact the active ones.
+  void Finish() {
+    size_t j = 0;
+    while (j < m_n) {
+      if (m_done[j] == 0) {
+        ++j;
+        continue;
+      }
+      auto& res = m_results[m_id[j]];
+      res.x = m_x[j];
+      res.y = m_y[j];
+      res.z = m_z[j];
+      res.t = m_t[j];
+      res.logGain = m_lg[j];
+      res.status = m_done[j];
+      res.nSteps = m_steps[j];
+      if (res.status == StatusHitWire) {
+        double tr = 0., lgr = 0., xs = 0., ys = 0.;
+        m_table->Lookup(m_x[j], m_y[j], tr, lgr);
+        m_table->Project(m_x[j], m_y[j], xs, ys);
+        if (m_doSignal) {
+          m_sensor->AddSignal(-m_w[j], res.t, res.t + tr, res.x, res.y,
+                              res.z, xs, ys, res.z, false, true);
+        }
+        res.x = xs;
+        res.y = ys;
+        res.t += tr;
+        res.logGain += lgr;
+      }
+      res.gain = std::exp(res.logGain);
+      // Move the last active lane into this slot.
+      const size_t last = --m_n;
+      if (j != last) {
+        m_id[j] = m_id[last];
+        m_x[j] = m_x[last];
+        m_y[j] = m_y[last];
+        m_z[j] = m_z[last];
+        m_t[j] = m_t[last];
+        m_w[j] = m_w[last];
+        m_h[j] = m_h[last];
+        m_lg[j] = m_lg[last];
+        m_alpha[j] = m_alpha[last];
+        m_k1x[j] = m_k1x[last];
+        m_k1y[j] = m_k1y[last];
+        m_k1z[j] = m_k1z[last];
+        m_steps[j] = m_steps[last];
+        m_done[j] = m_done[last];
+      }
+    }
+  }
+};
+
+}  // namespace IdeaDch
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef IDEA_DCH_CELL_SNAPSHOT_HH
+#define IDEA_DCH_CELL_SNAPSHOT_HH
+
+#include <array>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Garfield/ComponentAnalyticField.hh"
+#include "Garfield/Medium.hh"
+
+#include "ChamberSetup.hh"
+
+namespace IdeaDch {
+
+/// Frozen drift cell: a component built for one geometry, voltage setting
+/// and magnetic field, filled with a fully initialised medium, which any
+/// number of threads can query at the same time. The snapshot owns its
+/// component, so nothing can change it after freezing, and it triggers
+/// the preparations Garfield otherwise does lazily on the first field,
+/// weighting field and transport evaluation, which are not safe to run
+/// concurrently. All queries are const. The medium is not copied; it must
+/// outlive the snapshot and must not be changed (e.g. rescaled) while
+/// workers use it.
+class CellSnapshot {
+ public:
+  /// Build and freeze the cell; the labels are the electrodes whose
+  /// weighting fields the workers use.
+  static std::shared_ptr<const CellSnapshot> Create(
+      const CellParameters& cell, Garfield::Medium* medium,
+      const std::array<double, 3>& b = {0., 0., 0.},
+      const std::vector<std::string>& labels = {"s"}) {
+    if (!medium) {
+      std::cerr << "CellSnapshot::Create: Medium not set.\n";
+      return nullptr;
+    }
+    std::shared_ptr<CellSnapshot> snapshot(new CellSnapshot());
+    snapshot->m_medium = medium;
+    snapshot->m_labels = labels;
+    auto& cmp = *snapshot->m_cmp;
+    cmp.SetMedium(medium);
+    BuildCell(cmp, cell);
+    cmp.SetMagneticField(b[0], b[1], b[2]);
+    if (!snapshot->Prepare(cell)) return nullptr;
+    return snapshot;
+  }
+
+  Garfield::Medium* GetMedium() const { return m_medium; }
+  const std::vector<std::string>& GetLabels() const { return m_labels; }
+
+  void ElectricField(const double x, const double y, const double z,
+                     double& ex, double& ey, double& ez, double& v,
+                     Garfield::Medium*& m, int& status) const {
+    m_cmp->ElectricField(x, y, z, ex, ey, ez, v, m, status);
+  }
+  void ElectricField(const double x, const double y, const double z,
+                     double& ex, double& ey, double& ez, Garfield::Medium*& m,
+                     int& status) const {
+    m_cmp->ElectricField(x, y, z, ex, ey, ez, m, status);
+  }
+  void WeightingField(const double x, const double y, const double z,
+                      double& wx, double& wy, double& wz,
+                      const std::string& label) const {
+    m_cmp->WeightingField(x, y, z, wx, wy, wz, label);
+  }
+  double WeightingPotential(const double x, const double y, const double z,
+                            const std::string& label) const {
+    return m_cmp->WeightingPotential(x, y, z, label);
+  }
+  void MagneticField(const double x, const double y, const double z,
+                     double& bx, double& by, double& bz, int& status) const {
+    m_cmp->MagneticField(x, y, z, bx, by, bz, status);
+  }
+  Garfield::Medium* GetMedium(const double x, const double y,
+                              const double z) const {
+    return m_cmp->GetMedium(x, y, z);
+  }
+  bool GetVoltageRange(double& vmin, double& vmax) const {
+    vmin = m_vmin;
+    vmax = m_vmax;
+    return true;
+  }
+  bool GetBoundingBox(double& x0, double& y0, double& z0, double& x1,
+                      double& y1, double& z1) const {
+    x0 = m_box[0];
+    y0 = m_box[1];
+    z0 = m_box[2];
+    x1 = m_box[3];
+    y1 = m_box[4];
+    z1 = m_box[5];
+    return m_hasBox;
+  }
+  bool IsWireCrossed(const double x0, const double y0, const double z0,
+                     const double x1, const double y1, const double z1,
+                     double& xc, double& yc, double& zc, const bool centre,
+                     double& rc) const {
+    return m_cmp->IsWireCrossed(x0, y0, z0, x1, y1, z1, xc, yc, zc, centre,
+                                rc);
+  }
+  bool IsInTrapRadius(const double q0, const double x0, const double y0,
+                      const double z0, double& xw, double& yw,
+                      double& rw) const {
+    return m_cmp->IsInTrapRadius(q0, x0, y0, z0, xw, yw, rw);
+  }
+
+ private:
+  CellSnapshot()
+      : m_cmp(std::make_unique<Garfield::ComponentAnalyticField>()) {}
+
+  // The pointer is const, the component is not: the queries above call
+  // the non-const Garfield interface, which no longer changes any state
+  // once Prepare has run.
+  const std::unique_ptr<Garfield::ComponentAnalyticField> m_cmp;
+  Garfield::Medium* m_medium = nullptr;
+  std::vector<std::string> m_labels;
+  double m_vmin = 0., m_vmax = 0.;
+  std::array<double, 6> m_box = {0., 0., 0., 0., 0., 0.};
+  bool m_hasBox = false;
+
+  /// Evaluate everything once, at a point in the gas between the wires.
+  bool Prepare(const CellParameters& cell) {
+    const double x = 0.25 * cell.cellSize, y = 0.25 * cell.cellSize;
+    double ex = 0., ey = 0., ez = 0., v = 0.;
+    Garfield::Medium* m = nullptr;
+    int status = 0;
+    m_cmp->ElectricField(x, y, 0., ex, ey, ez, v, m, status);
+    if (status != 0 || !m) {
+      std::cerr << "CellSnapshot::Create: No field in the drift gas.\n";
+      return false;
+    }
+    for (const auto& label : m_labels) {
+      double wx = 0., wy = 0., wz = 0.;
+      m_cmp->WeightingField(x, y, 0., wx, wy, wz, label);
+      m_cmp->WeightingPotential(x, y, 0., label);
+    }
+    m_cmp->GetVoltageRange(m_vmin, m_vmax);
+    m_hasBox = m_cmp->GetBoundingBox(m_box[0], m_box[1], m_box[2], m_box[3],
+                                     m_box[4], m_box[5]);
+    double bx = 0., by = 0., bz = 0.;
+    m_cmp->MagneticField(x, y, 0., bx, by, bz, status);
+    // Transport: interpolation settings and tables of the medium.
+    double vx = 0., vy = 0., vz = 0., a = 0., dl = 0., dt = 0.;
+    m->ElectronVelocity(ex, ey, ez, bx, by, bz, vx, vy, vz);
+    m->ElectronTownsend(ex, ey, ez, bx, by, bz, a);
+    m->ElectronAttachment(ex, ey, ez, bx, by, bz, a);
+    m->ElectronDiffusion(ex, ey, ez, bx, by, bz, dl, dt);
+    m->IonVelocity(ex, ey, ez, bx, by, bz, vx, vy, vz);
+    return true;
+  }
+};
+
+/// Component through which one worker's Sensor sees a shared CellSnapshot.
+/// It holds nothing but the reference, so each extra thread costs only its
+/// own Sensor, drift engine and signal buffers.
+class CellView : public Garfield::Component {
+ public:
+  explicit CellView(std::shared_ptr<const CellSnapshot> snapshot)
+      : Garfield::Component("CellView"), m_snapshot(std::move(snapshot)) {}
+
+  Garfield::Medium* GetMedium(const double x, const double y,
+                              const double z) override {
+    return m_snapshot->GetMedium(x, y, z);
+  }
+  void ElectricField(const double x, const double y, const double z,
+                     double& ex, double& ey, double& ez, double& v,
+                     Garfield::Medium*& m, int& status) override {
+    m_snapshot->ElectricField(x, y, z, ex, ey, ez, v, m, status);
+  }
+  void ElectricField(const double x, const double y, const double z,
+                     double& ex, double& ey, double& ez, Garfield::Medium*& m,
+                     int& status) override {
+    m_snapshot->ElectricField(x, y, z, ex, ey, ez, m, status);
+  }
+  bool GetVoltageRange(double& vmin, double& vmax) override {
+    return m_snapshot->GetVoltageRange(vmin, vmax);
+  }
+  void WeightingField(const double x, const double y, const double z,
+                      double& wx, double& wy, double& wz,
+                      const std::string& label) override {
+    m_snapshot->WeightingField(x, y, z, wx, wy, wz, label);
+  }
+  double WeightingPotential(const double x, const double y, const double z,
+                            const std::string& label) override {
+    return m_snapshot->WeightingPotential(x, y, z, label);
+  }
+  void MagneticField(const double x, const double y, const double z,
+                     double& bx, double& by, double& bz, int& status) override {
+    m_snapshot->MagneticField(x, y, z, bx, by, bz, status);
+  }
+  bool GetBoundingBox(double& x0, double& y0, double& z0, double& x1,
+                      double& y1, double& z1) override {
+    return m_snapshot->GetBoundingBox(x0, y0, z0, x1, y1, z1);
+  }
+  bool IsWireCrossed(const double x0, const double y0, const double z0,
+                     const double x1, const double y1, const double z1,
+                     double& xc, double& yc, double& zc, const bool centre,
+                     double& rc) override {
+    return m_snapshot->IsWireCrossed(x0, y0, z0, x1, y1, z1, xc, yc, zc,
+                                     centre, rc);
+  }
+  bool IsInTrapRadius(const double q0, const double x0, const double y0,
+                      const double z0, double& xw, double& yw,
+                      double& rw) override {
+    return m_snapshot->IsInTrapRadius(q0, x0, y0, z0, xw, yw, rw);
+  }
+
+ protected:
+  void Reset() override {}
+  void UpdatePeriodicity() override {}
+
+ private:
+  std::shared_ptr<const CellSnapshot> m_snapshot;
+};
+
+}  // namespace IdeaDch
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef IDEA_DCH_CHAMBER_SETUP_HH
+#define IDEA_DCH_CHAMBER_SETUP_HH
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Garfield/ComponentAnalyticField.hh"
+#include "Garfield/Sensor.hh"
+
+namespace IdeaDch {
+
+/// Geometry and voltages of the drift cell.
+struct CellParameters {
+  double cellSize = 1.4;            // 14mm cell size [cm]
+  double senseWireRadius = 10.e-4;  // 20μm sense wire [cm]
+  double fieldWireRadius = 20.e-4;  // 40μm field wire [cm]
+  // Voltages (from MDT-like settings)
+  double senseVoltage = 2000.;
+  double fieldVoltage = 0.;         // Field wires grounded [V]
+  double boundaryVoltage = 0.;      // Boundary planes grounded [V]
+  // Half-width of the grounded boundary box in units of the cell size.
+  double boundaryFactor = 1.8;
+};
+
+/// Positions of the 12 field wires in square configuration around the
+/// sense wire.
+inline std::vector<std::pair<double, double> > FieldWirePositions(
+    const CellParameters& cell) {
+  const double wireSpacing = cell.cellSize / 2.0;
+  const double halfwireSpacing = wireSpacing / 2.0;
+  return {
+    {-wireSpacing, -wireSpacing}, // Bottom-left
+    {-wireSpacing,  0.0},         // Left
+    {-wireSpacing,  wireSpacing}, // Top-left
+    { 0.0,         wireSpacing},  // Top
+    { wireSpacing,  wireSpacing}, // Top-right
+    { wireSpacing,  0.0},         // Right
+    { wireSpacing, -wireSpacing}, // Bottom-right
+    { 0.0,        -wireSpacing},  // Bottom
+    { -halfwireSpacing,       -wireSpacing},
+    { -halfwireSpacing,        wireSpacing},
+    { halfwireSpacing,        -wireSpacing},
+    { halfwireSpacing,         wireSpacing},
+  };
+}
+
+/// Add the sense wire "s", the field wires and the boundary planes.
+inline void BuildCell(Garfield::ComponentAnalyticField& cmp,
+                      const CellParameters& cell, const bool verbose = false) {
+  if (verbose) std::cout << "Adding wires to geometry...\n";
+  // Add sense wire at center
+  cmp.AddWire(0.0, 0.0, cell.senseWireRadius, cell.senseVoltage, "s");
+  if (verbose) std::cout << "Added sense wire at (0, 0)\n";
+
+  const auto fieldPositions = FieldWirePositions(cell);
+  for (size_t i = 0; i < fieldPositions.size(); ++i) {
+    std::string label = "field" + std::to_string(i);
+    cmp.AddWire(fieldPositions[i].first, fieldPositions[i].second,
+                cell.fieldWireRadius, cell.fieldVoltage, label);
+    if (!verbose) continue;
+    std::cout << "Added field wire " << i << " at ("
+              << fieldPositions[i].first << ", " << fieldPositions[i].second << ")\n";
+  }
+
+  // Add boundary - SMALLER to ensure field coverage
+  const double boundary = cell.boundaryFactor * cell.cellSize;
+  const double vb = cell.boundaryVoltage;
+  cmp.AddPlaneX(-boundary, vb, "boundary");
+  cmp.AddPlaneX( boundary, vb, "boundary");
+  cmp.AddPlaneY(-boundary, vb, "boundary");
+  cmp.AddPlaneY( boundary, vb, "boundary");
+  if (verbose) std::cout << "Boundary set to ±" << boundary << " cm\n";
+}
+
+/// Read the delta response function of the front-end electronics.
+inline bool readTransferFunction(Garfield::Sensor& sensor,
+                                 const std::string& filename = "mdt_elx_delta.txt") {
+  std::ifstream infile;
+  infile.open(filename, std::ios::in);
+  if (!infile) {
+    std::cerr << "Could not read chamber transfer function.\n";
+    return false;
+  }
+  std::vector<double> times;
+  std::vector<double> values;
+  while (!infile.eof()) {
+    double t = 0., f = 0.;
+    infile >> t >> f;
+    if (infile.eof() || infile.fail()) break;
+    times.push_back(1.e3 * t);
+    values.push_back(f);
+  }
+  infile.close();
+  sensor.SetTransferFunction(times, values);
+  return true;
+}
+
+}  // namespace IdeaDch
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef IDEA_DCH_DISCRIMINATOR_HH
+#define IDEA_DCH_DISCRIMINATOR_HH
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace IdeaDch {
+
+/// TDC hit: leading edge time and time over threshold in TDC bins.
+struct TdcHit {
+  uint32_t time;
+  uint16_t tot;
+  uint8_t threshold;  // index in the sorted list of thresholds
+  uint8_t flags;
+  static constexpr uint8_t Open = 1;      // no trailing edge in the window
+  static constexpr uint8_t Overflow = 2;  // time over threshold saturated
+};
+
+/// Leading edges and time over threshold for a set of thresholds, found
+/// in a single pass over a waveform. All thresholds have the polarity of
+/// the pulses (negative thresholds for negative pulses). A threshold
+/// fires when the signal reaches it and is re-armed when the signal falls
+/// back below it by more than the hysteresis; the time over threshold is
+/// measured from the leading edge to that re-arming point, i.e. to the
+/// crossing of threshold - hysteresis, not of the threshold itself. As the
+/// hysteresis is the same for all thresholds, the active thresholds are
+/// always the lowest ones in magnitude, so per sample only the edge of
+/// that set is checked.
+class Discriminator {
+ public:
+  /// Set the thresholds; they are sorted by magnitude.
+  void SetThresholds(std::vector<double> thresholds) {
+    m_sign = !thresholds.empty() && thresholds.front() < 0. ? -1. : 1.;
+    for (auto& t : thresholds) t = std::abs(t);
+    std::sort(thresholds.begin(), thresholds.end());
+    if (thresholds.size() > 256) thresholds.resize(256);
+    m_thresholds = thresholds;
+  }
+  /// Thresholds in the order of the hit threshold index.
+  std::vector<double> GetThresholds() const {
+    std::vector<double> t = m_thresholds;
+    for (auto& x : t) x *= m_sign;
+    return t;
+  }
+  void SetHysteresis(const double h) { m_hysteresis = std::abs(h); }
+  /// TDC bin width [ns].
+  void SetTdcBinWidth(const double w) { m_tdcBin = w; }
+  double GetTdcBinWidth() const { return m_tdcBin; }
+
+  /// Append the hits of a waveform w[0..n) with samples at
+  /// tmin + i * tstep, in units of scale * w + offset. Holds no state
+  /// between calls, so threads may share a discriminator.
+  template <typename T>
+  size_t Process(const T* w, const size_t n, const double tmin,
+                 const double tstep, std::vector<TdcHit>& hits,
+                 const double scale = 1., const double offset = 0.) const {
+    const size_t nThr = m_thresholds.size();
+    if (nThr == 0 || n == 0) return 0;
+    const size_t first = hits.size();
+    const double a = m_sign * scale, b = m_sign * offset;
+    const double* thr = m_thresholds.data();
+    // Leading edge times of the active thresholds.
+    std::array<double, 256> start;
+    size_t nOn = 0;
+    double v0 = a * w[0] + b;
+    // Thresholds exceeded at the start of the window open at tmin.
+    while (nOn < nThr && v0 >= thr[nOn]) start[nOn++] = tmin;
+    for (size_t i = 1; i < n; ++i) {
+      const double v1 = a * w[i] + b;
+      if (nOn < nThr && v1 >= thr[nOn]) {
+        do {
+          start[nOn] = Crossing(tmin, tstep, i, v0, v1, thr[nOn]);
+          ++nOn;
+        } while (nOn < nThr && v1 >= thr[nOn]);
+      } else {
+        while (nOn > 0 && v1 < thr[nOn - 1] - m_hysteresis) {
+          --nOn;
+          const double level = thr[nOn] - m_hysteresis;
+          const double t1 = Crossing(tmin, tstep, i, v0, v1, level);
+          AddHit(nOn, start[nOn], t1, 0, hits);
+        }
+      }
+      v0 = v1;
+    }
+    const double tend = tmin + (n - 1) * tstep;
+    while (nOn > 0) {
+      --nOn;
+      AddHit(nOn, start[nOn], tend, TdcHit::Open, hits);
+    }
+    // Order by threshold, then by time.
+    std::sort(hits.begin() + first, hits.end(),
+              [](const TdcHit& h1, const TdcHit& h2) {
+                return h1.threshold != h2.threshold
+                           ? h1.threshold < h2.threshold
+                           : h1.time < h2.time;
+              });
+    return hits.size() - first;
+  }
+
+  /// Leading edge time [ns] of a hit.
+  double Time(const TdcHit& hit) const { return hit.time * m_tdcBin; }
+  /// Time over threshold [ns] of a hit, from the leading edge to the
+  /// crossing of threshold - hysteresis.
+  double Tot(const TdcHit& hit) const { return hit.tot * m_tdcBin; }
+
+ private:
+  std::vector<double> m_thresholds;
+  double m_sign = 1.;
+  double m_hysteresis = 0.;
+  double m_tdcBin = 0.1;  // [ns]
+
+  static double Crossing(const double tmin, const double tstep,
+                         const size_t i, const double v0, const double v1,
+                         const double level) {
+    const double f = v1 != v0 ? (level - v0) / (v1 - v0) : 1.;
+    return tmin + (i - 1 + std::clamp(f, 0., 1.)) * tstep;
+  }
+
+  void AddHit(const size_t k, const double t0, const double t1,
+              uint8_t flags, std::vector<TdcHit>& hits) const {
+    const double lead = std::max(0., std::round(t0 / m_tdcBin));
+    double tot = std::round((t1 - t0) / m_tdcBin);
+    if (tot > 65535.) {
+      tot = 65535.;
+      flags |= TdcHit::Overflow;
+    }
+    hits.push_back({static_cast<uint32_t>(lead),
+                    static_cast<uint16_t>(std::max(tot, 0.)),
+                    static_cast<uint8_t>(k), flags});
+  }
+};
+
+}  // namespace IdeaDch
+
+#endif
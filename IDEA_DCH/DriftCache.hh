@@ -0,0 +1,259 @@
+#ifndef IDEA_DCH_DRIFT_CACHE_HH
+#define IDEA_DCH_DRIFT_CACHE_HH
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Garfield/DriftLineRKF.hh"
+#include "Garfield/Random.hh"
+#include "Garfield/Sensor.hh"
+
+#include "NearWireDrift.hh"
+#include "PolyaSampler.hh"
+
+namespace IdeaDch {
+
+/// Deterministic part of a drift line: the mean path, the Townsend
+/// integral and the arrival time spread. The points keep the absolute x and
+/// y of the line that filled the entry (the field depends on them, and all
+/// starts in the same cell are replayed along it); z and t are offsets from
+/// the start, since the field does not depend on z.
+struct CachedDriftLine {
+  std::vector<std::array<double, 4> > points;
+  double logGain = 0.;
+  double timeSpread = 0.;
+  int status = 0;
+};
+
+/// Drift lines keyed on the start position quantised in (x, y), for a
+/// chamber whose field does not depend on z. Bounded in size with
+/// least-recently-used eviction; safe to share between threads. The
+/// entries are only valid for one geometry, voltage setting and gas, so
+/// the cache has to be cleared when any of them changes.
+class DriftCache {
+ public:
+  using Key = uint64_t;
+
+  /// Maximum number of drift lines and quantum of the start position [cm].
+  explicit DriftCache(const size_t capacity = 100000,
+                      const double quantum = 2.e-4)
+      : m_capacity(std::max<size_t>(capacity, 1)), m_quantum(quantum) {}
+
+  Key MakeKey(const double x, const double y) const {
+    const auto ix = static_cast<int32_t>(std::lround(x / m_quantum));
+    const auto iy = static_cast<int32_t>(std::lround(y / m_quantum));
+    return (Key(uint32_t(ix)) << 32) | uint32_t(iy);
+  }
+  /// Centre of the quantisation cell of (x, y).
+  void Centre(const double x, const double y, double& xc, double& yc) const {
+    xc = m_quantum * std::lround(x / m_quantum);
+    yc = m_quantum * std::lround(y / m_quantum);
+  }
+
+  std::shared_ptr<const CachedDriftLine> Find(const Key key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto it = m_index.find(key);
+    if (it == m_index.end()) {
+      ++m_misses;
+      return nullptr;
+    }
+    ++m_hits;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return it->second->second;
+  }
+
+  void Insert(const Key key, std::shared_ptr<const CachedDriftLine> line) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto it = m_index.find(key);
+    if (it != m_index.end()) {
+      // Another thread was faster; keep its entry.
+      m_lru.splice(m_lru.begin(), m_lru, it->second);
+      return;
+    }
+    m_lru.emplace_front(key, std::move(line));
+    m_index[key] = m_lru.begin();
+    if (m_lru.size() > m_capacity) {
+      m_index.erase(m_lru.back().first);
+      m_lru.pop_back();
+      ++m_evictions;
+    }
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lru.clear();
+    m_index.clear();
+  }
+
+  size_t GetSize() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lru.size();
+  }
+  double GetQuantum() const { return m_quantum; }
+  uint64_t GetHits() const { return m_hits; }
+  uint64_t GetMisses() const { return m_misses; }
+  double GetHitRate() const {
+    const double n = double(m_hits) + double(m_misses);
+    return n > 0. ? m_hits / n : 0.;
+  }
+  void PrintStatistics() const {
+    std::cout << "DriftCache: " << GetSize() << " drift lines, "
+              << m_hits + m_misses << " lookups, hit rate "
+              << 100. * GetHitRate() << "%, " << m_evictions
+              << " evictions\n";
+  }
+
+ private:
+  size_t m_capacity;
+  double m_quantum;
+  mutable std::mutex m_mutex;
+  std::list<std::pair<Key, std::shared_ptr<const CachedDriftLine> > > m_lru;
+  std::unordered_map<Key, decltype(m_lru)::iterator> m_index;
+  std::atomic<uint64_t> m_hits{0}, m_misses{0}, m_evictions{0};
+};
+
+/// Drift through a DriftCache in front of an engine (DriftLineRKF or
+/// HybridDriftRKF), with the interface of HybridDriftRKF. On a miss the
+/// engine drifts an electron from the centre of the quantisation cell,
+/// without signal; the stored drift line then serves every electron
+/// starting in that cell (the start point error is below half a quantum).
+/// Hits and misses alike get the fluctuations on top: the arrival time is
+/// smeared with the spread from longitudinal diffusion (DriftLineRKF
+/// only), the gain is sampled from a Polya distribution, and the signal
+/// is induced along the stored path. Each thread needs its own CachedDrift
+/// and engine; the cache can be shared.
+template <class Engine>
+class CachedDrift {
+ public:
+  CachedDrift(Engine* engine, Garfield::Sensor* sensor, DriftCache* cache)
+      : m_engine(engine), m_sensor(sensor), m_cache(cache) {}
+
+  void EnableSignalCalculation(const bool on = true) { m_doSignal = on; }
+  /// Smear the arrival time by the longitudinal diffusion (default on).
+  void EnableDiffusion(const bool on = true) { m_diffusion = on; }
+  /// Sample the gain from a Polya distribution. A mean gain <= 0 means
+  /// that the Townsend integral is used as mean.
+  void SetGainFluctuationsPolya(const double theta, const double mean) {
+    m_polya.Build(theta, 1.);
+    m_meanGain = mean;
+    m_fluctuate = true;
+  }
+
+  /// Drift an electron which represents weight electrons in the signal.
+  bool DriftElectron(const double x0, const double y0, const double z0,
+                     const double t0, const double weight = 1.) {
+    const auto key = m_cache->MakeKey(x0, y0);
+    auto line = m_cache->Find(key);
+    if (!line) {
+      line = Compute(x0, y0);
+      m_cache->Insert(key, line);
+    }
+    m_status = line->status;
+    m_points.clear();
+    if (line->points.empty()) return false;
+    // Stretch the drift time uniformly by the diffusion smearing.
+    const double tDrift = line->points.back()[3];
+    double stretch = 1.;
+    if (m_diffusion && line->timeSpread > 0. && tDrift > 0.) {
+      const double t1 = tDrift + line->timeSpread * Garfield::RndmGaussian();
+      stretch = std::max(t1, 0.) / tDrift;
+    }
+    m_points.push_back({x0, y0, z0, t0});
+    for (size_t i = 1; i < line->points.size(); ++i) {
+      const auto& p = line->points[i];
+      m_points.push_back({p[0], p[1], z0 + p[2], t0 + stretch * p[3]});
+    }
+    if (m_doSignal) {
+      for (size_t i = 1; i < m_points.size(); ++i) {
+        const auto& p = m_points[i - 1];
+        const auto& q = m_points[i];
+        m_sensor->AddSignal(-weight, p[3], q[3], p[0], p[1], p[2], q[0],
+                            q[1], q[2], false, true);
+      }
+    }
+    m_logGain = line->logGain;
+    m_gain = std::exp(m_logGain);
+    if (m_fluctuate && m_status == HybridDriftRKF::StatusHitWire) {
+      const double mean = m_meanGain > 0. ? m_meanGain : m_gain;
+      m_gain = mean * m_polya.Sample();
+    }
+    return true;
+  }
+
+  void GetEndPoint(double& x, double& y, double& z, double& t,
+                   int& status) const {
+    if (m_points.empty()) return;
+    x = m_points.back()[0];
+    y = m_points.back()[1];
+    z = m_points.back()[2];
+    t = m_points.back()[3];
+    status = m_status;
+  }
+  double GetGain() const { return m_gain; }
+  double GetLogGain() const { return m_logGain; }
+  size_t GetNumberOfDriftLinePoints() const { return m_points.size(); }
+  void GetDriftLinePoint(const size_t i, double& x, double& y, double& z,
+                         double& t) const {
+    if (i >= m_points.size()) return;
+    x = m_points[i][0];
+    y = m_points[i][1];
+    z = m_points[i][2];
+    t = m_points[i][3];
+  }
+
+ private:
+  Engine* m_engine = nullptr;
+  Garfield::Sensor* m_sensor = nullptr;
+  DriftCache* m_cache = nullptr;
+  bool m_doSignal = true;
+  bool m_diffusion = true;
+  bool m_fluctuate = false;
+  PolyaSampler m_polya;
+  double m_meanGain = 0.;
+
+  std::vector<std::array<double, 4> > m_points;
+  double m_gain = 1.;
+  double m_logGain = 0.;
+  int m_status = 0;
+
+  /// Drift line from the centre of the quantisation cell of (x0, y0),
+  /// starting at z = 0 and t = 0.
+  std::shared_ptr<const CachedDriftLine> Compute(const double x0,
+                                                 const double y0) {
+    auto line = std::make_shared<CachedDriftLine>();
+    double xc = 0., yc = 0.;
+    m_cache->Centre(x0, y0, xc, yc);
+    m_engine->EnableSignalCalculation(false);
+    m_engine->DriftElectron(xc, yc, 0., 0.);
+    m_engine->EnableSignalCalculation(true);
+    const size_t n = m_engine->GetNumberOfDriftLinePoints();
+    line->points.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+      auto& p = line->points[i];
+      m_engine->GetDriftLinePoint(i, p[0], p[1], p[2], p[3]);
+    }
+    double x = 0., y = 0., z = 0., t = 0.;
+    m_engine->GetEndPoint(x, y, z, t, line->status);
+    if constexpr (std::is_same_v<Engine, HybridDriftRKF>) {
+      line->logGain = m_engine->GetLogGain();
+    } else {
+      line->logGain = std::log(std::max(m_engine->GetGain(), 1.));
+      line->timeSpread = m_engine->GetArrivalTimeSpread();
+    }
+    return line;
+  }
+};
+
+}  // namespace IdeaDch
+
+#endif
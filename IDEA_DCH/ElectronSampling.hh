@@ -0,0 +1,74 @@
+#ifndef IDEA_DCH_ELECTRON_SAMPLING_HH
+#define IDEA_DCH_ELECTRON_SAMPLING_HH
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#include "Garfield/Random.hh"
+
+namespace IdeaDch {
+
+/// Random sub-sampling of the electrons of a cluster with statistical
+/// weights, so that the expected signal is unchanged.
+class ElectronSampler {
+ public:
+  enum class Mode {
+    All,         // drift every electron
+    Fraction,    // drift a random fraction of the electrons of each cluster
+    PerCluster   // drift at most a fixed number of electrons per cluster
+  };
+
+  ElectronSampler() = default;
+  ElectronSampler(const Mode mode, const double value) { Set(mode, value); }
+
+  /// Set the mode, and the fraction or number of electrons per cluster.
+  void Set(const Mode mode, const double value) {
+    m_mode = mode;
+    m_value = value;
+  }
+  Mode GetMode() const { return m_mode; }
+
+  /// Pick the electrons to drift out of a cluster of n electrons.
+  /// Returns the statistical weight of each picked electron.
+  double Select(const size_t n, std::vector<size_t>& picked) const {
+    picked.resize(n);
+    std::iota(picked.begin(), picked.end(), 0);
+    if (n == 0) return 0.;
+    size_t m = n;
+    if (m_mode == Mode::Fraction) {
+      m = static_cast<size_t>(std::lround(m_value * n));
+    } else if (m_mode == Mode::PerCluster) {
+      m = static_cast<size_t>(m_value);
+    }
+    m = std::clamp<size_t>(m, 1, n);
+    if (m == n) return 1.;
+    // Partial Fisher-Yates shuffle.
+    for (size_t i = 0; i < m; ++i) {
+      const size_t j = i + std::min<size_t>(Garfield::RndmUniform() * (n - i),
+                                            n - i - 1);
+      std::swap(picked[i], picked[j]);
+    }
+    picked.resize(m);
+    std::sort(picked.begin(), picked.end());
+    return double(n) / m;
+  }
+
+  /// Gain of a weighted electron, given the gain g of a single avalanche
+  /// with mean gain mean. The result has mean w * mean and the variance of
+  /// the sum of w independent avalanches.
+  static double WeightedGain(const double g, const double mean,
+                             const double w) {
+    if (w == 1.) return g;
+    return w * mean + std::sqrt(w) * (g - mean);
+  }
+
+ private:
+  Mode m_mode = Mode::All;
+  double m_value = 1.;
+};
+
+}  // namespace IdeaDch
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef IDEA_DCH_EVENT_ARENA_HH
+#define IDEA_DCH_EVENT_ARENA_HH
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+namespace IdeaDch {
+
+/// Memory resource which forwards to an upstream resource and counts the
+/// requests passing through it.
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  explicit CountingResource(
+      std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+      : m_upstream(upstream) {}
+
+  void SetUpstream(std::pmr::memory_resource* upstream) {
+    m_upstream = upstream;
+  }
+  size_t GetAllocations() const { return m_allocations; }
+  size_t GetBytes() const { return m_bytes; }
+  void ResetCounters() {
+    m_allocations = 0;
+    m_bytes = 0;
+  }
+
+ private:
+  std::pmr::memory_resource* m_upstream = nullptr;
+  size_t m_allocations = 0;
+  size_t m_bytes = 0;
+
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    ++m_allocations;
+    m_bytes += bytes;
+    return m_upstream->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    m_upstream->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource& other) const
+      noexcept override {
+    return this == &other;
+  }
+};
+
+/// Event-scoped bump allocator. All objects allocated from it during an
+/// event are released wholesale by Reset(). The slab grows to the largest
+/// event seen so far, so in steady state no request reaches the heap.
+class EventArena {
+ public:
+  explicit EventArena(const size_t initialSize = 1 << 20)
+      : m_size(std::max<size_t>(initialSize, 4096)) {
+    Allocate();
+  }
+
+  /// Resource to be passed to the per-event containers.
+  std::pmr::memory_resource* Resource() { return &m_counter; }
+
+  /// Release all per-event objects and, if the last event overflowed the
+  /// slab, enlarge it for the next one.
+  void Reset() {
+    m_lastAllocations = m_counter.GetAllocations();
+    m_lastBytes = m_counter.GetBytes();
+    m_lastHeapAllocations = m_heap.GetAllocations();
+    m_arena->release();
+    if (m_lastHeapAllocations > 0) {
+      m_size = std::max(2 * m_size, 2 * m_lastBytes);
+      m_arena.reset();
+      Allocate();
+    }
+    m_counter.ResetCounters();
+    m_heap.ResetCounters();
+  }
+
+  /// Number of allocations served during the last event.
+  size_t GetLastAllocations() const { return m_lastAllocations; }
+  /// Number of bytes requested during the last event.
+  size_t GetLastBytes() const { return m_lastBytes; }
+  /// Number of allocations which had to go to the heap during the last event.
+  size_t GetLastHeapAllocations() const { return m_lastHeapAllocations; }
+  /// Current slab size [bytes].
+  size_t GetSlabSize() const { return m_size; }
+
+ private:
+  size_t m_size = 0;
+  std::unique_ptr<std::byte[]> m_slab;
+  CountingResource m_heap;
+  std::optional<std::pmr::monotonic_buffer_resource> m_arena;
+  CountingResource m_counter{nullptr};
+
+  size_t m_lastAllocations = 0;
+  size_t m_lastBytes = 0;
+  size_t m_lastHeapAllocations = 0;
+
+  void Allocate() {
+    m_slab = std::make_unique<std::byte[]>(m_size);
+    m_arena.emplace(m_slab.get(), m_size, &m_heap);
+    m_counter.SetUpstream(&*m_arena);
+  }
+};
+
+/// Ionising collision of the current event.
+struct ClusterRecord {
+  double x = 0., y = 0., z = 0., t = 0.;
+  double energy = 0.;
+  // Range of this cluster's electrons in EventRecord::electrons.
+  size_t firstElectron = 0;
+  size_t nElectrons = 0;
+};
+
+/// Drift result of one primary electron.
+struct ElectronRecord {
+  double x0 = 0., y0 = 0., z0 = 0., t0 = 0.;
+  double x1 = 0., y1 = 0., z1 = 0., t1 = 0.;
+  double gain = 0.;
+  // Number of electrons this one stands for (0: not drifted).
+  double weight = 1.;
+  int status = 0;
+  bool drifted = false;
+  // Range of this electron's drift line in EventRecord::driftPoints.
+  size_t firstPoint = 0;
+  size_t nPoints = 0;
+};
+
+/// Per-event objects of the chamber simulation, flattened into a few
+/// vectors which all allocate from the same (event-scoped) resource.
+struct EventRecord {
+  explicit EventRecord(std::pmr::memory_resource* mr)
+      : clusters(mr), electrons(mr), driftPoints(mr), signal(mr) {}
+
+  std::pmr::vector<ClusterRecord> clusters;
+  std::pmr::vector<ElectronRecord> electrons;
+  // (x, y, z, t) of the drift lines which are needed after the drift
+  // (weighted signals); empty for most engines.
+  std::pmr::vector<std::array<double, 4> > driftPoints;
+  // Induced current on the sense wire, one entry per time bin.
+  std::pmr::vector<double> signal;
+};
+
+}  // namespace IdeaDch
+
+#endif
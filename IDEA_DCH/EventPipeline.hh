@@ -0,0 +1,287 @@
+#ifndef IDEA_DCH_EVENT_PIPELINE_HH
+#define IDEA_DCH_EVENT_PIPELINE_HH
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace IdeaDch {
+
+/// Bounded lock-free multi-producer multi-consumer queue (D. Vyukov's
+/// ring of sequenced cells). The capacity is rounded up to a power of two.
+template <class T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(const size_t capacity) {
+    size_t n = 2;
+    while (n < capacity) n *= 2;
+    m_mask = n - 1;
+    m_cells = std::make_unique<Cell[]>(n);
+    for (size_t i = 0; i < n; ++i) m_cells[i].sequence.store(i);
+  }
+
+  bool TryPush(T value) {
+    size_t pos = m_tail.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = m_cells[pos & m_mask];
+      const size_t seq = cell.sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+      if (diff == 0) {
+        if (m_tail.compare_exchange_weak(pos, pos + 1,
+                                         std::memory_order_relaxed)) {
+          cell.value = std::move(value);
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // full
+      } else {
+        pos = m_tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool TryPop(T& value) {
+    size_t pos = m_head.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& cell = m_cells[pos & m_mask];
+      const size_t seq = cell.sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+      if (diff == 0) {
+        if (m_head.compare_exchange_weak(pos, pos + 1,
+                                         std::memory_order_relaxed)) {
+          value = std::move(cell.value);
+          cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // empty
+      } else {
+        pos = m_head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /// Number of queued items (approximate while others push and pop).
+  size_t Size() const {
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+  size_t Capacity() const { return m_mask + 1; }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+  std::unique_ptr<Cell[]> m_cells;
+  size_t m_mask = 0;
+  alignas(64) std::atomic<size_t> m_tail{0};
+  alignas(64) std::atomic<size_t> m_head{0};
+};
+
+/// Items flow from a source stage through processing stages, each run by
+/// its own threads, with a bounded queue in front of every stage after the
+/// source. Stages are created per thread by a factory, so that each thread
+/// owns its objects. Items may overtake each other in stages with more
+/// than one thread. Per stage, the statistics give the busy time, the time
+/// spent waiting for input or for room downstream, and the depth of the
+/// input queue, which together show the stage limiting the throughput.
+template <class Item>
+class EventPipeline {
+ public:
+  using ItemPtr = std::unique_ptr<Item>;
+  /// Returns the next item, or nullptr when the input is exhausted.
+  using Source = std::function<ItemPtr()>;
+  using Stage = std::function<void(Item&)>;
+
+  explicit EventPipeline(const size_t queueCapacity = 8)
+      : m_capacity(queueCapacity) {}
+
+  void SetSource(const std::string& name, const unsigned int nThreads,
+                 std::function<Source(unsigned int)> factory) {
+    auto s = std::make_unique<StageData>(name, std::max(nThreads, 1u));
+    s->sourceFactory = std::move(factory);
+    if (m_stages.empty()) {
+      m_stages.push_back(std::move(s));
+    } else {
+      m_stages.front() = std::move(s);
+    }
+  }
+
+  void AddStage(const std::string& name, const unsigned int nThreads,
+                std::function<Stage(unsigned int)> factory) {
+    if (m_stages.empty()) m_stages.push_back(nullptr);
+    auto s = std::make_unique<StageData>(name, std::max(nThreads, 1u));
+    s->stageFactory = std::move(factory);
+    s->input = std::make_unique<BoundedQueue<Item*> >(m_capacity);
+    m_stages.push_back(std::move(s));
+  }
+
+  /// Process all items of the source; returns the number of items which
+  /// left the last stage.
+  size_t Run() {
+    if (m_stages.empty() || !m_stages.front()) return 0;
+    const auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t k = 0; k < m_stages.size(); ++k) {
+      auto& s = *m_stages[k];
+      s.Reset();
+      for (unsigned int w = 0; w < s.nThreads; ++w) {
+        threads.emplace_back(&EventPipeline::Work, this, k, w);
+      }
+    }
+    for (auto& t : threads) t.join();
+    m_wall = Seconds(Clock::now() - start);
+    return m_stages.back()->processed;
+  }
+
+  void PrintStatistics() const {
+    std::printf("%-10s %7s %8s %9s %9s %9s %7s %9s\n", "stage", "threads",
+                "items", "busy [%]", "wait in", "wait out", "depth",
+                "max depth");
+    size_t limit = 0;
+    double maxBusy = -1.;
+    for (size_t k = 0; k < m_stages.size(); ++k) {
+      const auto& s = *m_stages[k];
+      const double total = std::max(s.nThreads * m_wall, 1.e-9);
+      const double busy = s.busy / total;
+      const double depth = s.samples > 0 ? double(s.depthSum) / s.samples : 0.;
+      std::printf("%-10s %7u %8zu %9.1f %8.1f%% %8.1f%% %7.2f %5zu/%zu\n",
+                  s.name.c_str(), s.nThreads, size_t(s.processed),
+                  100. * busy, 100. * s.waitIn / total,
+                  100. * s.waitOut / total, depth, size_t(s.maxDepth),
+                  s.input ? s.input->Capacity() : 0);
+      if (busy > maxBusy) {
+        maxBusy = busy;
+        limit = k;
+      }
+    }
+    std::printf("%.2f s, %.1f items/s; limiting stage: %s\n", m_wall,
+                m_wall > 0. ? m_stages.back()->processed / m_wall : 0.,
+                m_stages[limit]->name.c_str());
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct StageData {
+    StageData(const std::string& n, const unsigned int t)
+        : name(n), nThreads(t) {}
+    std::string name;
+    unsigned int nThreads;
+    std::function<Source(unsigned int)> sourceFactory;
+    std::function<Stage(unsigned int)> stageFactory;
+    std::unique_ptr<BoundedQueue<Item*> > input;
+    std::atomic<unsigned int> active{0};
+    std::atomic<bool> done{false};
+    // Statistics, summed over the threads when they finish.
+    std::mutex mutex;
+    double busy = 0., waitIn = 0., waitOut = 0.;
+    std::atomic<size_t> processed{0};
+    uint64_t depthSum = 0, samples = 0;
+    size_t maxDepth = 0;
+
+    void Reset() {
+      active = nThreads;
+      done = false;
+      busy = waitIn = waitOut = 0.;
+      processed = 0;
+      depthSum = samples = 0;
+      maxDepth = 0;
+    }
+  };
+
+  size_t m_capacity;
+  std::vector<std::unique_ptr<StageData> > m_stages;
+  double m_wall = 0.;
+
+  static double Seconds(const Clock::duration d) {
+    return std::chrono::duration<double>(d).count();
+  }
+
+  /// Spin briefly, then yield, then sleep.
+  static void Backoff(unsigned int& n) {
+    if (++n < 64) return;
+    if (n < 128) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+  void Work(const size_t k, const unsigned int w) {
+    auto& s = *m_stages[k];
+    StageData* next = k + 1 < m_stages.size() ? m_stages[k + 1].get() : nullptr;
+    StageData* prev = k > 0 ? m_stages[k - 1].get() : nullptr;
+    double busy = 0., waitIn = 0., waitOut = 0.;
+    uint64_t depthSum = 0, samples = 0;
+    size_t maxDepth = 0;
+    Source source;
+    Stage stage;
+    if (prev) {
+      stage = s.stageFactory(w);
+    } else {
+      source = s.sourceFactory(w);
+    }
+    for (;;) {
+      // Next item: from the source or from the input queue.
+      Item* item = nullptr;
+      auto t0 = Clock::now();
+      if (!prev) {
+        item = source().release();
+        if (!item) break;
+      } else {
+        unsigned int n = 0;
+        bool upstreamDone = false;
+        for (;;) {
+          upstreamDone = prev->done.load(std::memory_order_acquire);
+          if (s.input->TryPop(item)) break;
+          if (upstreamDone) break;
+          Backoff(n);
+        }
+        if (!item) break;
+        const size_t depth = s.input->Size();
+        depthSum += depth;
+        ++samples;
+        maxDepth = std::max(maxDepth, depth + 1);
+        const auto t1 = Clock::now();
+        waitIn += Seconds(t1 - t0);
+        t0 = t1;
+        stage(*item);
+      }
+      const auto t1 = Clock::now();
+      busy += Seconds(t1 - t0);
+      ++s.processed;
+      if (!next) {
+        delete item;
+        continue;
+      }
+      unsigned int n = 0;
+      while (!next->input->TryPush(item)) Backoff(n);
+      waitOut += Seconds(Clock::now() - t1);
+    }
+    {
+      std::lock_guard<std::mutex> lock(s.mutex);
+      s.busy += busy;
+      s.waitIn += waitIn;
+      s.waitOut += waitOut;
+      s.depthSum += depthSum;
+      s.samples += samples;
+      s.maxDepth = std::max(s.maxDepth, maxDepth);
+    }
+    if (--s.active == 0) s.done.store(true, std::memory_order_release);
+  }
+};
+
+}  // namespace IdeaDch
+
+#endif
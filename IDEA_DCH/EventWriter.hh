@@ -0,0 +1,195 @@
+#ifndef IDEA_DCH_EVENT_WRITER_HH
+#define IDEA_DCH_EVENT_WRITER_HH
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Compression.h>
+#include <TFile.h>
+#include <TROOT.h>
+#include <TTree.h>
+
+namespace IdeaDch {
+
+/// Output of one simulated event, in columns.
+struct EventOutput {
+  unsigned int run = 0;
+  unsigned long event = 0;
+  // Clusters.
+  std::vector<double> clusterX, clusterY, clusterZ, clusterT, clusterE;
+  std::vector<int> clusterSize;
+  // Drifted electrons.
+  std::vector<int> electronCluster;
+  std::vector<double> electronT0, electronT1, electronGain, electronWeight;
+  std::vector<int> electronStatus;
+  // TDC hits of the sense wire signal.
+  std::vector<uint32_t> tdcTime;
+  std::vector<uint16_t> tdcTot;
+  std::vector<uint8_t> tdcThreshold, tdcFlags;
+  // Convoluted sense wire signal and its ADC codes (optional), as
+  // FrontEnd::Digitise gives them (up to 30 bits).
+  std::vector<float> waveform;
+  std::vector<int32_t> adc;
+};
+
+/// Writes events to a ROOT TTree with one branch per column from a
+/// dedicated thread. Simulation threads hand over events through a
+/// bounded queue and never touch the file themselves.
+class EventWriter {
+ public:
+  EventWriter(const std::string& filename, const size_t capacity = 64,
+              const bool writeWaveforms = false)
+      : m_filename(filename),
+        m_capacity(std::max<size_t>(capacity, 1)),
+        m_writeWaveforms(writeWaveforms) {
+    ROOT::EnableThreadSafety();
+    m_thread = std::thread(&EventWriter::Run, this);
+  }
+  ~EventWriter() { Close(); }
+
+  EventWriter(const EventWriter&) = delete;
+  EventWriter& operator=(const EventWriter&) = delete;
+
+  /// Queue an event for writing. Blocks only if the queue is full.
+  /// If the file could not be opened, the event is dropped.
+  void Push(EventOutput&& ev) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_queue.size() >= m_capacity && !m_failed) {
+      const auto t0 = std::chrono::steady_clock::now();
+      m_notFull.wait(lock, [this] {
+        return m_queue.size() < m_capacity || m_failed;
+      });
+      m_waitTime += std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - t0).count();
+    }
+    if (m_failed) {
+      ++m_dropped;
+      return;
+    }
+    m_queue.push_back(std::move(ev));
+    m_maxDepth = std::max(m_maxDepth, m_queue.size());
+    ++m_pushed;
+    m_notEmpty.notify_one();
+  }
+
+  /// Write the remaining events and close the file.
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_closed) return;
+      m_closed = true;
+    }
+    m_notEmpty.notify_one();
+    if (m_thread.joinable()) m_thread.join();
+    if (m_failed) {
+      std::cerr << "EventWriter::Close: Nothing written to " << m_filename
+                << ", " << m_dropped << " events dropped.\n";
+      return;
+    }
+    std::cout << "EventWriter::Close: " << m_written << " events written to "
+              << m_filename << " (max. queue depth " << m_maxDepth << "/"
+              << m_capacity << ", producers waited " << m_waitTime
+              << " s).\n";
+  }
+
+  size_t GetNumberOfWrittenEvents() const { return m_written; }
+  /// The output file could not be opened; events are being dropped.
+  bool IsFailed() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_failed;
+  }
+
+ private:
+  std::string m_filename;
+  size_t m_capacity;
+  bool m_writeWaveforms;
+
+  std::thread m_thread;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_notEmpty;
+  std::condition_variable m_notFull;
+  std::deque<EventOutput> m_queue;
+  bool m_closed = false;
+  bool m_failed = false;
+
+  size_t m_pushed = 0;
+  size_t m_dropped = 0;
+  // Written by the writer thread, read by anyone.
+  std::atomic<size_t> m_written{0};
+  size_t m_maxDepth = 0;
+  double m_waitTime = 0.;
+
+  void Run() {
+    // Everything ROOT is created and used in this thread only.
+    TFile file(m_filename.c_str(), "RECREATE", "IDEA drift chamber events",
+               ROOT::CompressionSettings(
+                   ROOT::RCompressionSetting::EAlgorithm::kZSTD, 5));
+    if (file.IsZombie()) {
+      std::cerr << "EventWriter: Could not open " << m_filename << ".\n";
+      // Discard what is queued and release any waiting producer.
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_failed = true;
+        m_dropped += m_queue.size();
+        m_queue.clear();
+      }
+      m_notFull.notify_all();
+      return;
+    }
+    TTree tree("events", "IDEA drift chamber events");
+    // Write a cluster of baskets every 1000 events.
+    tree.SetAutoFlush(1000);
+    EventOutput ev;
+    constexpr int split = 99;
+    tree.Branch("run", &ev.run);
+    tree.Branch("event", &ev.event);
+    tree.Branch("clusterX", &ev.clusterX, 32000, split);
+    tree.Branch("clusterY", &ev.clusterY, 32000, split);
+    tree.Branch("clusterZ", &ev.clusterZ, 32000, split);
+    tree.Branch("clusterT", &ev.clusterT, 32000, split);
+    tree.Branch("clusterE", &ev.clusterE, 32000, split);
+    tree.Branch("clusterSize", &ev.clusterSize, 32000, split);
+    tree.Branch("electronCluster", &ev.electronCluster, 32000, split);
+    tree.Branch("electronT0", &ev.electronT0, 32000, split);
+    tree.Branch("electronT1", &ev.electronT1, 32000, split);
+    tree.Branch("electronGain", &ev.electronGain, 32000, split);
+    tree.Branch("electronWeight", &ev.electronWeight, 32000, split);
+    tree.Branch("electronStatus", &ev.electronStatus, 32000, split);
+    tree.Branch("tdcTime", &ev.tdcTime, 32000, split);
+    tree.Branch("tdcTot", &ev.tdcTot, 32000, split);
+    tree.Branch("tdcThreshold", &ev.tdcThreshold, 32000, split);
+    tree.Branch("tdcFlags", &ev.tdcFlags, 32000, split);
+    if (m_writeWaveforms) {
+      tree.Branch("waveform", &ev.waveform, 32000, split);
+      tree.Branch("adc", &ev.adc, 32000, split);
+    }
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this] { return !m_queue.empty() || m_closed; });
+        if (m_queue.empty()) break;
+        ev = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+      m_notFull.notify_one();
+      tree.Fill();
+      ++m_written;
+    }
+    file.cd();
+    tree.Write();
+    file.Close();
+  }
+};
+
+}  // namespace IdeaDch
+
+#endif
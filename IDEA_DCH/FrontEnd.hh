@@ -0,0 +1,255 @@
+#ifndef IDEA_DCH_FRONT_END_HH
+#define IDEA_DCH_FRONT_END_HH
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Garfield/Random.hh"
+
+namespace IdeaDch {
+
+/// In-place radix-2 FFT of a fixed size with precomputed twiddle factors
+/// and bit reversal.
+class Fft {
+ public:
+  /// Prepare for transforms of length n (a power of two).
+  void Initialise(const size_t n) {
+    m_n = n;
+    m_rev.resize(n);
+    unsigned int bits = 0;
+    while ((size_t(1) << bits) < n) ++bits;
+    for (size_t i = 0; i < n; ++i) {
+      size_t r = 0;
+      for (unsigned int b = 0; b < bits; ++b) {
+        r |= ((i >> b) & 1) << (bits - 1 - b);
+      }
+      m_rev[i] = r;
+    }
+    m_w.resize(n / 2);
+    for (size_t k = 0; k < n / 2; ++k) {
+      m_w[k] = std::polar(1., 2. * M_PI * k / n);
+    }
+  }
+  size_t Size() const { return m_n; }
+
+  /// Unnormalised inverse transform, x_j = sum_k X_k exp(+2 pi i j k / n).
+  void Inverse(std::complex<double>* a) const {
+    for (size_t i = 0; i < m_n; ++i) {
+      if (i < m_rev[i]) std::swap(a[i], a[m_rev[i]]);
+    }
+    for (size_t len = 2; len <= m_n; len <<= 1) {
+      const size_t half = len / 2;
+      const size_t stride = m_n / len;
+      for (size_t i = 0; i < m_n; i += len) {
+        for (size_t k = 0; k < half; ++k) {
+          const auto t = m_w[k * stride] * a[i + k + half];
+          a[i + k + half] = a[i + k] - t;
+          a[i + k] += t;
+        }
+      }
+    }
+  }
+
+ private:
+  size_t m_n = 0;
+  std::vector<size_t> m_rev;
+  std::vector<std::complex<double> > m_w;
+};
+
+/// Front-end electronics after the shaper: coloured noise, per-channel
+/// baseline and gain, and an ADC. Works on all waveforms of an event at
+/// once, stored channel after channel in one array.
+class FrontEnd {
+ public:
+  /// Read the noise power spectral density (frequency [MHz], density in
+  /// arbitrary units); only its shape is used.
+  bool LoadNoiseSpectrum(const std::string& filename) {
+    std::ifstream infile(filename);
+    if (!infile) {
+      std::cerr << "FrontEnd::LoadNoiseSpectrum: Could not open " << filename
+                << ".\n";
+      return false;
+    }
+    std::vector<double> f, s;
+    double x = 0., y = 0.;
+    while (infile >> x >> y) {
+      f.push_back(1.e-3 * x);
+      s.push_back(y);
+    }
+    if (f.size() < 2) return false;
+    m_specFreq = f;
+    m_specDensity = s;
+    return true;
+  }
+  /// Without a stored spectrum, the noise is white up to a first-order
+  /// low pass at this bandwidth [GHz].
+  void SetNoiseBandwidth(const double fc) { m_bandwidth = fc; }
+  /// Rms of the noise, in units of the signal.
+  void SetNoiseRms(const double rms) { m_noiseRms = rms; }
+  /// Spread of the channel baselines (around 0) and of the relative gains
+  /// (around 1).
+  void SetChannelVariation(const double baselineSigma,
+                           const double gainSigma) {
+    m_baselineSigma = baselineSigma;
+    m_gainSigma = gainSigma;
+  }
+  /// ADC sampling period [ns], resolution and input range.
+  void SetAdc(const double period, const unsigned int bits, const double vmin,
+              const double vmax) {
+    m_period = period;
+    m_bits = std::clamp(bits, 1u, 30u);
+    m_vmin = vmin;
+    m_vmax = vmax;
+  }
+
+  /// Prepare for nChannels waveforms of nbins bins of width tstep [ns]
+  /// starting at tmin: ADC sampling times (from tmin on), noise filter and
+  /// channel constants.
+  void Initialise(const unsigned int nChannels, const double tmin,
+                  const double tstep, const unsigned int nbins) {
+    m_nChannels = nChannels;
+    m_nBins = nbins;
+    m_tmin = tmin;
+    m_nSamples =
+        std::max(1u, static_cast<unsigned int>(nbins * tstep / m_period));
+    // Position of each ADC sample in the input binning.
+    m_bin.resize(m_nSamples);
+    m_frac.resize(m_nSamples);
+    for (unsigned int i = 0; i < m_nSamples; ++i) {
+      const double u = i * m_period / tstep;
+      const unsigned int k = std::min(static_cast<unsigned int>(u), nbins - 1);
+      m_bin[i] = k;
+      m_frac[i] = k + 1 < nbins ? std::min(u - k, 1.) : 0.;
+    }
+    // Amplitude filter for the noise at the FFT frequencies.
+    size_t n = 1;
+    while (n < m_nSamples) n <<= 1;
+    m_fft.Initialise(n);
+    m_filter.resize(n);
+    double sum = 0.;
+    for (size_t k = 0; k < n; ++k) {
+      const double f = std::min(k, n - k) / (n * m_period);
+      m_filter[k] = k == 0 ? 0. : std::sqrt(Density(f));
+      sum += m_filter[k] * m_filter[k];
+    }
+    // With unit complex Gaussian coefficients, the real and the imaginary
+    // part of the transform each have variance sum.
+    const double scale = sum > 0. ? m_noiseRms / std::sqrt(sum) : 0.;
+    for (auto& a : m_filter) a *= scale;
+    m_buffer.resize(n);
+    m_noise.assign(size_t(m_nChannels) * m_nSamples, 0.);
+    // Channel constants.
+    m_baseline.resize(nChannels);
+    m_gain.resize(nChannels);
+    for (unsigned int c = 0; c < nChannels; ++c) {
+      m_baseline[c] = m_baselineSigma * Garfield::RndmGaussian();
+      m_gain[c] = std::max(0., 1. + m_gainSigma * Garfield::RndmGaussian());
+    }
+    m_lsb = (m_vmax - m_vmin) / (1u << m_bits);
+  }
+
+  unsigned int GetNumberOfSamples() const { return m_nSamples; }
+  /// Time of the first ADC sample [ns].
+  double GetStartTime() const { return m_tmin; }
+  double GetSamplingPeriod() const { return m_period; }
+  double GetLsb() const { return m_lsb; }
+  /// Signal level corresponding to an ADC code.
+  double Level(const int32_t code) const {
+    return m_vmin + (code + 0.5) * m_lsb;
+  }
+
+  /// Digitise the waveforms (nChannels x nbins, channel after channel)
+  /// into ADC codes (nChannels x GetNumberOfSamples()).
+  void Digitise(const double* waveforms, std::vector<int32_t>& codes) {
+    GenerateNoise();
+    const size_t nAll = size_t(m_nChannels) * m_nSamples;
+    codes.resize(nAll);
+    const int32_t maxCode = (int32_t(1) << m_bits) - 1;
+    const double invLsb = 1. / m_lsb;
+    for (unsigned int c = 0; c < m_nChannels; ++c) {
+      const double* w = waveforms + size_t(c) * m_nBins;
+      const double* noise = m_noise.data() + size_t(c) * m_nSamples;
+      int32_t* out = codes.data() + size_t(c) * m_nSamples;
+      const double g = m_gain[c];
+      const double offset = m_baseline[c] - m_vmin;
+      for (unsigned int i = 0; i < m_nSamples; ++i) {
+        const unsigned int k = m_bin[i];
+        const unsigned int k1 = std::min(k + 1, m_nBins - 1);
+        const double s = w[k] + m_frac[i] * (w[k1] - w[k]);
+        const double u = (g * s + noise[i] + offset) * invLsb;
+        out[i] = std::clamp(static_cast<int32_t>(std::floor(u)), int32_t(0),
+                            maxCode);
+      }
+    }
+  }
+
+ private:
+  Fft m_fft;
+  std::vector<double> m_specFreq, m_specDensity;
+  double m_bandwidth = 0.2;  // [GHz]
+  double m_noiseRms = 0.;
+  double m_baselineSigma = 0.;
+  double m_gainSigma = 0.;
+  double m_period = 0.5;  // [ns]
+  unsigned int m_bits = 12;
+  double m_vmin = -100.;
+  double m_vmax = 100.;
+  double m_lsb = 1.;
+
+  unsigned int m_nChannels = 0;
+  unsigned int m_nBins = 0;
+  double m_tmin = 0.;
+  unsigned int m_nSamples = 0;
+  std::vector<unsigned int> m_bin;
+  std::vector<double> m_frac;
+  std::vector<double> m_filter;
+  std::vector<std::complex<double> > m_buffer;
+  std::vector<double> m_noise;
+  std::vector<double> m_baseline;
+  std::vector<double> m_gain;
+
+  /// Noise power density at frequency f [GHz].
+  double Density(const double f) const {
+    if (m_specFreq.empty()) {
+      const double x = f / m_bandwidth;
+      return 1. / (1. + x * x);
+    }
+    if (f <= m_specFreq.front()) return m_specDensity.front();
+    if (f >= m_specFreq.back()) return m_specDensity.back();
+    const auto it = std::upper_bound(m_specFreq.begin(), m_specFreq.end(), f);
+    const size_t i = it - m_specFreq.begin() - 1;
+    const double t = (f - m_specFreq[i]) / (m_specFreq[i + 1] - m_specFreq[i]);
+    return m_specDensity[i] + t * (m_specDensity[i + 1] - m_specDensity[i]);
+  }
+
+  /// Fill the noise of all channels, two channels per inverse FFT: a
+  /// symmetric spectrum with independent complex Gaussian coefficients
+  /// transforms into two independent real sequences with that density.
+  void GenerateNoise() {
+    if (m_noiseRms <= 0.) return;
+    const size_t n = m_fft.Size();
+    for (unsigned int c = 0; c < m_nChannels; c += 2) {
+      for (size_t k = 0; k < n; ++k) {
+        const double re = Garfield::RndmGaussian();
+        const double im = Garfield::RndmGaussian();
+        m_buffer[k] = {m_filter[k] * re, m_filter[k] * im};
+      }
+      m_fft.Inverse(m_buffer.data());
+      double* a = m_noise.data() + size_t(c) * m_nSamples;
+      for (unsigned int i = 0; i < m_nSamples; ++i) a[i] = m_buffer[i].real();
+      if (c + 1 == m_nChannels) break;
+      double* b = a + m_nSamples;
+      for (unsigned int i = 0; i < m_nSamples; ++i) b[i] = m_buffer[i].imag();
+    }
+  }
+};
+
+}  // namespace IdeaDch
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef IDEA_DCH_GAS_DENSITY_SCALING_HH
+#define IDEA_DCH_GAS_DENSITY_SCALING_HH
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "Garfield/MediumGas.hh"
+
+namespace IdeaDch {
+
+/// Use of a gas table at a pressure and temperature other than those it
+/// was generated at, by E/N scaling. The swarm parameters depend on the
+/// reduced field E/N, so at the density ratio r = N / N0 = (p / p0)(T0 / T)
+/// the drift velocity at field E is that of the table at E / r, the
+/// diffusion coefficients (sigma per sqrt(cm)) scale as 1 / sqrt(r) and
+/// the Townsend and two-body attachment coefficients as r.
+///
+/// MediumGas applies exactly this scaling with the ratio of its pressure
+/// to the pressure of the table, but ignores the temperature. The
+/// temperature is therefore folded into an effective pressure p T0 / T,
+/// with the medium kept at T0; the number density seen by Heed,
+/// proportional to p / T, is the same. Not scaled: B / N (the Lorentz
+/// angle), three-body attachment and the thermal motion of the gas, which
+/// matters only at low E/N, where it limits the temperature range.
+class GasDensityScaling {
+ public:
+  /// Record the conditions and the field range of a freshly loaded table.
+  void Attach(Garfield::MediumGas* gas) {
+    m_gas = gas;
+    m_pressure0 = gas->GetPressure();
+    m_temperature0 = gas->GetTemperature();
+    m_ratio = 1.;
+    std::vector<double> efields, bfields, angles;
+    gas->GetFieldGrid(efields, bfields, angles);
+    m_emin = efields.empty() ? 0. : efields.front();
+    m_emax = efields.empty() ? 0. : efields.back();
+    m_magnetised = bfields.size() > 1;
+  }
+
+  /// Operating pressure [Torr] and temperature [K]; values <= 0 stand for
+  /// those of the table.
+  bool Apply(double pressure, double temperature) {
+    if (!m_gas) {
+      std::cerr << "GasDensityScaling::Apply: No gas attached.\n";
+      return false;
+    }
+    if (pressure <= 0.) pressure = m_pressure0;
+    if (temperature <= 0.) temperature = m_temperature0;
+    m_ratio = (pressure / m_pressure0) * (m_temperature0 / temperature);
+    m_gas->SetTemperature(m_temperature0);
+    m_gas->SetPressure(m_pressure0 * m_ratio);
+    if (std::abs(temperature / m_temperature0 - 1.) > MaxTemperatureChange) {
+      std::cerr << "GasDensityScaling::Apply: " << temperature
+                << " K is far from the " << m_temperature0 << " K of the "
+                << "table; E/N scaling neglects the thermal motion of the "
+                << "gas.\n";
+    }
+    if (m_magnetised && std::abs(m_ratio - 1.) > 0.01) {
+      std::cerr << "GasDensityScaling::Apply: B/N is not scaled; the "
+                << "Lorentz angle is that of the table density.\n";
+    }
+    return true;
+  }
+
+  /// Density relative to the table.
+  double GetDensityRatio() const { return m_ratio; }
+  /// Fields [V/cm] covered by the table at the current density.
+  double GetMinimumField() const { return m_emin * m_ratio; }
+  double GetMaximumField() const { return m_emax * m_ratio; }
+
+  /// Check that fields from emin to emax are within the (scaled) table;
+  /// outside, the medium extrapolates.
+  bool CheckRange(const double emin, const double emax) const {
+    const double lo = GetMinimumField(), hi = GetMaximumField();
+    if (emin >= lo && emax <= hi) return true;
+    std::cerr << "GasDensityScaling::CheckRange: Fields from " << emin
+              << " to " << emax << " V/cm, the table covers " << lo << " to "
+              << hi << " V/cm at density ratio " << m_ratio << ".\n";
+    return false;
+  }
+
+  /// Largest relative temperature change regarded as safe.
+  static constexpr double MaxTemperatureChange = 0.15;
+
+ private:
+  Garfield::MediumGas* m_gas = nullptr;
+  double m_pressure0 = 760.;
+  double m_temperature0 = 293.15;
+  double m_ratio = 1.;
+  double m_emin = 0., m_emax = 0.;
+  bool m_magnetised = false;
+};
+
+}  // namespace IdeaDch
+
+#endif
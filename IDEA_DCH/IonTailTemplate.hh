@@ -0,0 +1,102 @@
+#ifndef IDEA_DCH_ION_TAIL_TEMPLATE_HH
+#define IDEA_DCH_ION_TAIL_TEMPLATE_HH
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Garfield/DriftLineRKF.hh"
+#include "Garfield/Sensor.hh"
+
+namespace IdeaDch {
+
+/// Current induced by the ions of an avalanche, computed once per cell
+/// geometry, voltage setting and ion mobility and then added as a scaled,
+/// time-shifted copy for each avalanche instead of drifting the ions.
+class IonTailTemplate {
+ public:
+  /// Drift single ions from the surface of the wire at (xw, yw) with
+  /// radius rw, at nAngles azimuths, and record the mean current per ion
+  /// induced on the electrode "label". The signal of the sensor is cleared.
+  bool Build(Garfield::Sensor& sensor, const std::string& label,
+             const double xw, const double yw, const double rw,
+             const unsigned int nAngles = 8) {
+    sensor.GetTimeWindow(m_tmin, m_tstep, m_nbins);
+    if (m_nbins == 0 || nAngles == 0) return false;
+    Garfield::DriftLineRKF drift(&sensor);
+    // Start slightly outside the wire surface.
+    const double r0 = 1.05 * rw;
+    sensor.ClearSignal();
+    for (unsigned int i = 0; i < nAngles; ++i) {
+      const double phi = 2. * M_PI * (i + 0.5) / nAngles;
+      drift.DriftIon(xw + r0 * std::cos(phi), yw + r0 * std::sin(phi), 0.,
+                     m_tmin);
+    }
+    m_template.assign(m_nbins, 0.);
+    for (unsigned int k = 0; k < m_nbins; ++k) {
+      m_template[k] = sensor.GetSignal(label, k) / nAngles;
+    }
+    sensor.ClearSignal();
+    m_charge.assign(m_nbins + 1, 0.);
+    // Only the leading part which is non-negligible needs to be convolved.
+    double imax = 0.;
+    for (const auto f : m_template) imax = std::max(imax, std::abs(f));
+    m_length = m_nbins;
+    while (m_length > 1 && std::abs(m_template[m_length - 1]) < 1.e-6 * imax) {
+      --m_length;
+    }
+    std::cout << "IonTailTemplate::Build: " << m_length << " of " << m_nbins
+              << " bins, peak current " << imax << " fC/ns per ion.\n";
+    return imax > 0.;
+  }
+
+  bool IsReady() const { return !m_template.empty(); }
+
+  /// Remove the avalanches of the previous event.
+  void Clear() { std::fill(m_charge.begin(), m_charge.end(), 0.); }
+
+  /// Register an avalanche of nIons ions created at time t.
+  void AddAvalanche(const double t, const double nIons) {
+    const double u = (t - m_tmin) / m_tstep;
+    if (u < 0. || u >= m_nbins) return;
+    const unsigned int j = static_cast<unsigned int>(u);
+    const double f = u - j;
+    m_charge[j] += (1. - f) * nIons;
+    m_charge[j + 1] += f * nIons;
+  }
+
+  /// Add the ion current of all registered avalanches to the signal of
+  /// electrode "label".
+  void AddTo(Garfield::Sensor& sensor, const std::string& label) const {
+    std::vector<double> current(m_nbins, 0.);
+    for (unsigned int j = 0; j < m_nbins; ++j) {
+      const double q = m_charge[j];
+      if (q == 0.) continue;
+      const unsigned int kmax = std::min(m_nbins, j + m_length);
+      for (unsigned int k = j; k < kmax; ++k) {
+        current[k] += q * m_template[k - j];
+      }
+    }
+    for (unsigned int k = 0; k < m_nbins; ++k) {
+      if (current[k] == 0.) continue;
+      sensor.SetSignal(label, k, sensor.GetSignal(label, k) + current[k]);
+    }
+  }
+
+  /// Current per ion at time bin k after the avalanche.
+  const std::vector<double>& GetTemplate() const { return m_template; }
+
+ private:
+  double m_tmin = 0.;
+  double m_tstep = 1.;
+  unsigned int m_nbins = 0;
+  unsigned int m_length = 0;
+  std::vector<double> m_template;
+  std::vector<double> m_charge;
+};
+
+}  // namespace IdeaDch
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef IDEA_DCH_MAGNETIC_FIELD_MAP_HH
+#define IDEA_DCH_MAGNETIC_FIELD_MAP_HH
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace IdeaDch {
+
+/// Magnetic field [T], either uniform or tabulated on a regular grid in
+/// (x, y, z) and interpolated trilinearly. Outside the grid the field at
+/// the nearest edge is used.
+class MagneticFieldMap {
+ public:
+  void SetUniform(const double bx, const double by, const double bz) {
+    m_b.clear();
+    m_uniform = {bx, by, bz};
+  }
+
+  /// Read a map: "nx ny nz", "xmin xmax ymin ymax zmin zmax" [cm], then
+  /// nx * ny * nz lines "bx by bz" [T] with x running fastest.
+  bool Load(const std::string& filename) {
+    std::ifstream infile(filename);
+    if (!infile) {
+      std::cerr << "MagneticFieldMap::Load: Could not open " << filename
+                << ".\n";
+      return false;
+    }
+    unsigned int n[3] = {0, 0, 0};
+    double lo[3], hi[3];
+    infile >> n[0] >> n[1] >> n[2];
+    for (int k = 0; k < 3; ++k) infile >> lo[k] >> hi[k];
+    if (!infile || n[0] < 2 || n[1] < 2 || n[2] < 2) {
+      std::cerr << "MagneticFieldMap::Load: Invalid header in " << filename
+                << ".\n";
+      return false;
+    }
+    const size_t nAll = size_t(n[0]) * n[1] * n[2];
+    std::vector<std::array<double, 3> > b(nAll);
+    for (auto& v : b) {
+      if (!(infile >> v[0] >> v[1] >> v[2])) {
+        std::cerr << "MagneticFieldMap::Load: " << filename << " has fewer "
+                  << "than " << nAll << " nodes.\n";
+        return false;
+      }
+    }
+    for (int k = 0; k < 3; ++k) {
+      m_n[k] = n[k];
+      m_lo[k] = lo[k];
+      m_step[k] = (hi[k] - lo[k]) / (n[k] - 1);
+    }
+    m_b = std::move(b);
+    std::cout << "MagneticFieldMap::Load: " << n[0] << " x " << n[1] << " x "
+              << n[2] << " nodes, max. |B| = " << GetMaximum() << " T.\n";
+    return true;
+  }
+
+  bool IsUniform() const { return m_b.empty(); }
+  bool IsZero() const {
+    return IsUniform() && m_uniform[0] == 0. && m_uniform[1] == 0. &&
+           m_uniform[2] == 0.;
+  }
+
+  /// Largest |B| in the map [T].
+  double GetMaximum() const {
+    double b2 = Norm2(m_uniform);
+    for (const auto& v : m_b) b2 = std::max(b2, Norm2(v));
+    return std::sqrt(b2);
+  }
+
+  void Field(const double x, const double y, const double z, double& bx,
+             double& by, double& bz) const {
+    if (m_b.empty()) {
+      bx = m_uniform[0];
+      by = m_uniform[1];
+      bz = m_uniform[2];
+      return;
+    }
+    const double p[3] = {x, y, z};
+    size_t i[3];
+    double f[3];
+    for (int k = 0; k < 3; ++k) {
+      const double u = std::clamp((p[k] - m_lo[k]) / m_step[k], 0.,
+                                  m_n[k] - 1.000001);
+      i[k] = static_cast<size_t>(u);
+      f[k] = u - i[k];
+    }
+    const size_t sx = 1, sy = m_n[0], sz = size_t(m_n[0]) * m_n[1];
+    const size_t i0 = i[0] * sx + i[1] * sy + i[2] * sz;
+    double b[3] = {0., 0., 0.};
+    for (int c = 0; c < 8; ++c) {
+      const int dx = c & 1, dy = (c >> 1) & 1, dz = (c >> 2) & 1;
+      const double w = (dx ? f[0] : 1. - f[0]) * (dy ? f[1] : 1. - f[1]) *
+                       (dz ? f[2] : 1. - f[2]);
+      const auto& v = m_b[i0 + dx * sx + dy * sy + dz * sz];
+      for (int k = 0; k < 3; ++k) b[k] += w * v[k];
+    }
+    bx = b[0];
+    by = b[1];
+    bz = b[2];
+  }
+
+ private:
+  std::array<double, 3> m_uniform = {0., 0., 0.};
+  unsigned int m_n[3] = {0, 0, 0};
+  double m_lo[3] = {0., 0., 0.};
+  double m_step[3] = {1., 1., 1.};
+  std::vector<std::array<double, 3> > m_b;
+
+  static double Norm2(const std::array<double, 3>& v) {
+    return v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+  }
+};
+
+}  // namespace IdeaDch
+
+#endif
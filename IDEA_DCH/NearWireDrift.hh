@@ -0,0 +1,432 @@
+#ifndef IDEA_DCH_NEAR_WIRE_DRIFT_HH
+#define IDEA_DCH_NEAR_WIRE_DRIFT_HH
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "Garfield/Medium.hh"
+#include "Garfield/Sensor.hh"
+
+#include "MagneticFieldMap.hh"
+#include "PolyaSampler.hh"
+
+namespace IdeaDch {
+
+/// Runge-Kutta-Fehlberg 4(5) coefficients.
+namespace Rkf45 {
+constexpr double a21 = 1. / 4.;
+constexpr double a31 = 3. / 32., a32 = 9. / 32.;
+constexpr double a41 = 1932. / 2197., a42 = -7200. / 2197., a43 = 7296. / 2197.;
+constexpr double a51 = 439. / 216., a52 = -8., a53 = 3680. / 513.,
+                 a54 = -845. / 4104.;
+constexpr double a61 = -8. / 27., a62 = 2., a63 = -3544. / 2565.,
+                 a64 = 1859. / 4104., a65 = -11. / 40.;
+// 4th order weights.
+constexpr double b1 = 25. / 216., b3 = 1408. / 2565., b4 = 2197. / 4104.,
+                 b5 = -1. / 5.;
+// 5th order weights.
+constexpr double c1 = 16. / 135., c3 = 6656. / 12825., c4 = 28561. / 56430.,
+                 c5 = -9. / 50., c6 = 2. / 55.;
+}  // namespace Rkf45
+
+/// Drift time and Townsend integral from radius r to the surface of a wire,
+/// tabulated on a logarithmic grid in r. Valid where the field is radial.
+/// In a magnetic field, the time is integrated with the radial component
+/// of the drift velocity, averaged over the azimuth.
+class RadialTable {
+ public:
+  /// Magnetic field to use in Build; its value at the wire is taken.
+  void SetMagneticField(const MagneticFieldMap* field) { m_bfield = field; }
+
+  /// Sample the field around the wire at (xw, yw) with radius rw between
+  /// rw and rc, and integrate 1 / v and alpha - eta inwards.
+  bool Build(Garfield::Sensor& sensor, const double xw, const double yw,
+             const double rw, const double rc, const unsigned int nR = 256,
+             const unsigned int nPhi = 16) {
+    if (rc <= rw || nR < 2 || nPhi == 0) return false;
+    m_xw = xw;
+    m_yw = yw;
+    m_rw = rw;
+    m_rc = rc;
+    m_lrw = std::log(rw);
+    m_dlr = (std::log(rc) - m_lrw) / (nR - 1);
+    m_time.assign(nR, 0.);
+    m_logGain.assign(nR, 0.);
+    std::vector<double> emag(nR, 0.);
+    double maxSpread = 0.;
+    double maxTangential = 0.;
+    for (unsigned int i = 0; i < nR; ++i) {
+      const double r = std::exp(m_lrw + i * m_dlr);
+      double emin = 0., emax = 0., esum = 0.;
+      for (unsigned int j = 0; j < nPhi; ++j) {
+        const double phi = 2. * M_PI * (j + 0.5) / nPhi;
+        const double c = std::cos(phi), s = std::sin(phi);
+        double ex = 0., ey = 0., ez = 0.;
+        Garfield::Medium* medium = nullptr;
+        int status = 0;
+        sensor.ElectricField(xw + r * c, yw + r * s, 0., ex, ey, ez, medium,
+                             status);
+        if (!medium && i > 0) {
+          std::cerr << "RadialTable::Build: No medium at r = " << r << ".\n";
+          return false;
+        }
+        if (medium) m_medium = medium;
+        const double e = std::sqrt(ex * ex + ey * ey + ez * ez);
+        const double et = std::abs(-s * ex + c * ey);
+        if (e > 0.) maxTangential = std::max(maxTangential, et / e);
+        emin = j == 0 ? e : std::min(emin, e);
+        emax = j == 0 ? e : std::max(emax, e);
+        esum += e;
+      }
+      emag[i] = esum / nPhi;
+      if (emag[i] > 0.) maxSpread = std::max(maxSpread, (emax - emin) / emag[i]);
+    }
+    if (!m_medium) return false;
+    // Integrate from the wire surface outwards (trapezoidal rule in r).
+    std::vector<double> invV(nR, 0.), alpha(nR, 0.);
+    double bx = 0., by = 0., bz = 0.;
+    if (m_bfield) m_bfield->Field(xw, yw, 0., bx, by, bz);
+    const bool magnetic = bx != 0. || by != 0. || bz != 0.;
+    for (unsigned int i = 0; i < nR; ++i) {
+      // Radial field pointing outwards; electrons drift inwards.
+      const double e = emag[i];
+      if (!magnetic) {
+        double vx = 0., vy = 0., vz = 0.;
+        if (!m_medium->ElectronVelocity(e, 0., 0., 0., 0., 0., vx, vy, vz)) {
+          return false;
+        }
+        const double v = std::sqrt(vx * vx + vy * vy + vz * vz);
+        invV[i] = v > 0. ? 1. / v : 0.;
+        double a = 0., eta = 0.;
+        m_medium->ElectronTownsend(e, 0., 0., 0., 0., 0., a);
+        m_medium->ElectronAttachment(e, 0., 0., 0., 0., 0., eta);
+        alpha[i] = a - eta;
+        continue;
+      }
+      // The Lorentz angle depends on the direction of E relative to B.
+      // Average over the azimuths where electrons move towards the wire.
+      double sumInvV = 0., sumAlpha = 0.;
+      unsigned int nUsed = 0;
+      for (unsigned int j = 0; j < nPhi; ++j) {
+        const double phi = 2. * M_PI * (j + 0.5) / nPhi;
+        const double c = std::cos(phi), s = std::sin(phi);
+        double vx = 0., vy = 0., vz = 0.;
+        if (!m_medium->ElectronVelocity(e * c, e * s, 0., bx, by, bz, vx, vy,
+                                        vz)) {
+          return false;
+        }
+        const double vr = -(c * vx + s * vy);
+        double a = 0., eta = 0.;
+        m_medium->ElectronTownsend(e * c, e * s, 0., bx, by, bz, a);
+        m_medium->ElectronAttachment(e * c, e * s, 0., bx, by, bz, eta);
+        // Path length per unit radius is v / vr.
+        const double v = std::sqrt(vx * vx + vy * vy + vz * vz);
+        if (vr <= 0.) continue;
+        sumInvV += 1. / vr;
+        sumAlpha += (a - eta) * v / vr;
+        ++nUsed;
+      }
+      if (nUsed == 0) {
+        std::cerr << "RadialTable::Build: No inward drift at r = "
+                  << std::exp(m_lrw + i * m_dlr) << ".\n";
+        return false;
+      }
+      invV[i] = sumInvV / nUsed;
+      alpha[i] = sumAlpha / nUsed;
+    }
+    for (unsigned int i = 1; i < nR; ++i) {
+      const double r0 = std::exp(m_lrw + (i - 1) * m_dlr);
+      const double r1 = std::exp(m_lrw + i * m_dlr);
+      const double dr = r1 - r0;
+      m_time[i] = m_time[i - 1] + 0.5 * dr * (invV[i - 1] + invV[i]);
+      m_logGain[i] = m_logGain[i - 1] + 0.5 * dr * (alpha[i - 1] + alpha[i]);
+    }
+    std::cout << "RadialTable::Build: r = " << rw * 1.e4 << " - " << rc * 1.e4
+              << " um, drift time " << m_time.back() << " ns, gain "
+              << std::exp(m_logGain.back()) << ".\n"
+              << "    Max. azimuthal variation of |E|: " << 100. * maxSpread
+              << "%, max. tangential component: " << 100. * maxTangential
+              << "%.\n";
+    return true;
+  }
+
+  bool IsReady() const { return !m_time.empty(); }
+  double GetWireRadius() const { return m_rw; }
+  double GetRadius() const { return m_rc; }
+
+  /// Is the point (x, y) inside the tabulated region?
+  bool Inside(const double x, const double y) const {
+    const double dx = x - m_xw, dy = y - m_yw;
+    return dx * dx + dy * dy < m_rc * m_rc;
+  }
+
+  /// Distance of the point (x, y) from the wire centre.
+  double Distance(const double x, const double y) const {
+    return std::hypot(x - m_xw, y - m_yw);
+  }
+
+  /// Remaining drift time and Townsend integral from (x, y) to the wire.
+  void Lookup(const double x, const double y, double& t,
+              double& logGain) const {
+    const double r = std::max(Distance(x, y), m_rw);
+    const double u = (std::log(r) - m_lrw) / m_dlr;
+    const size_t n = m_time.size();
+    const size_t i = std::min(static_cast<size_t>(u), n - 2);
+    const double f = std::min(u - i, 1.);
+    t = m_time[i] + f * (m_time[i + 1] - m_time[i]);
+    logGain = m_logGain[i] + f * (m_logGain[i + 1] - m_logGain[i]);
+  }
+
+  /// Point on the wire surface along the line from (x, y) to the centre.
+  void Project(const double x, const double y, double& xs, double& ys) const {
+    const double dx = x - m_xw, dy = y - m_yw;
+    const double r = std::hypot(dx, dy);
+    xs = r > 0. ? m_xw + m_rw * dx / r : m_xw + m_rw;
+    ys = r > 0. ? m_yw + m_rw * dy / r : m_yw;
+  }
+
+ private:
+  Garfield::Medium* m_medium = nullptr;
+  const MagneticFieldMap* m_bfield = nullptr;
+  double m_xw = 0., m_yw = 0.;
+  double m_rw = 0., m_rc = 0.;
+  double m_lrw = 0., m_dlr = 1.;
+  std::vector<double> m_time;
+  std::vector<double> m_logGain;
+};
+
+/// Runge-Kutta-Fehlberg drift of electrons outside a radius rc around the
+/// sense wire, completed by a RadialTable lookup inside rc.
+/// Mirrors the interface of DriftLineRKF for the electron case.
+class HybridDriftRKF {
+ public:
+  explicit HybridDriftRKF(Garfield::Sensor* sensor) : m_sensor(sensor) {}
+
+  /// Radial table of the sense wire, which must be built beforehand.
+  void SetRadialTable(const RadialTable* table) { m_table = table; }
+  void EnableSignalCalculation(const bool on = true) { m_doSignal = on; }
+  /// Requested position accuracy per step [cm].
+  void SetAccuracy(const double eps) { m_accuracy = eps; }
+  void SetMaximumStepSize(const double ds) { m_maxStep = ds; }
+  /// Magnetic field passed to the medium for the drift velocity.
+  void SetMagneticField(const MagneticFieldMap* field) { m_bfield = field; }
+  /// Sample the gain from a Polya distribution. A mean gain <= 0 means
+  /// that the Townsend integral is used as mean.
+  void SetGainFluctuationsPolya(const double theta, const double mean) {
+    m_polya.Build(theta, 1.);
+    m_meanGain = mean;
+    m_fluctuate = true;
+  }
+
+  /// Drift an electron which represents weight electrons in the signal.
+  /// Returns false if the drift could not start or was abandoned.
+  bool DriftElectron(const double x0, const double y0, const double z0,
+                     const double t0, const double weight = 1.) {
+    m_points.clear();
+    m_gain = 1.;
+    m_status = 0;
+    m_nSteps = 0;
+    if (!m_table || !m_table->IsReady()) {
+      std::cerr << "HybridDriftRKF::DriftElectron: Radial table not set.\n";
+      return false;
+    }
+    std::array<double, 3> x = {x0, y0, z0};
+    double t = t0;
+    double logGain = 0.;
+    std::array<double, 3> v;
+    double alpha = 0.;
+    if (!Velocity(x, v, alpha)) {
+      m_status = StatusLeftDriftMedium;
+      m_points.push_back({x[0], x[1], x[2], t});
+      return false;
+    }
+    m_points.push_back({x[0], x[1], x[2], t});
+    double speed = Norm(v);
+    double dt = speed > 0. ? std::min(m_maxStep, 1.e-3) / speed : 1.;
+    constexpr unsigned int maxSteps = 10000;
+    while (!m_table->Inside(x[0], x[1])) {
+      if (++m_nSteps > maxSteps || speed <= 0.) {
+        m_status = StatusCalculationAbandoned;
+        break;
+      }
+      // Do not step across the tabulated region into the wire.
+      const double dsMax = std::min(
+          m_maxStep, std::max(0.5 * (m_table->Distance(x[0], x[1]) -
+                                     m_table->GetWireRadius()),
+                              0.1 * m_table->GetRadius()));
+      if (speed * dt > dsMax) dt = dsMax / speed;
+      std::array<double, 3> x1;
+      double err = 0.;
+      if (!Step(x, v, dt, x1, err)) {
+        // Step left the drift medium; retry with a smaller one.
+        dt *= 0.5;
+        if (speed * dt < 1.e-8) {
+          m_status = StatusLeftDriftMedium;
+          break;
+        }
+        continue;
+      }
+      if (err > m_accuracy && speed * dt > 1.e-8) {
+        dt *= std::max(0.1, 0.9 * std::pow(m_accuracy / err, 0.2));
+        continue;
+      }
+      std::array<double, 3> v1;
+      double alpha1 = 0.;
+      if (!Velocity(x1, v1, alpha1)) {
+        dt *= 0.5;
+        continue;
+      }
+      const double t1 = t + dt;
+      if (m_doSignal) {
+        m_sensor->AddSignal(-weight, t, t1, x[0], x[1], x[2], x1[0], x1[1],
+                            x1[2], false, true);
+      }
+      logGain += 0.5 * dt * speed * (alpha + alpha1);
+      x = x1;
+      v = v1;
+      t = t1;
+      alpha = alpha1;
+      speed = Norm(v);
+      m_points.push_back({x[0], x[1], x[2], t});
+      const double scale =
+          err > 0. ? 0.9 * std::pow(m_accuracy / err, 0.2) : 4.;
+      dt *= std::min(4., std::max(0.1, scale));
+    }
+    if (m_status == 0) {
+      // Complete the drift line with the radial table.
+      double tr = 0., lgr = 0.;
+      m_table->Lookup(x[0], x[1], tr, lgr);
+      double xs = 0., ys = 0.;
+      m_table->Project(x[0], x[1], xs, ys);
+      if (m_doSignal) {
+        m_sensor->AddSignal(-weight, t, t + tr, x[0], x[1], x[2], xs, ys,
+                            x[2], false, true);
+      }
+      t += tr;
+      logGain += lgr;
+      m_points.push_back({xs, ys, x[2], t});
+      m_status = StatusHitWire;
+    }
+    m_logGain = logGain;
+    const double mean = m_meanGain > 0. ? m_meanGain : std::exp(logGain);
+    if (m_status != StatusHitWire) {
+      m_gain = std::exp(logGain);
+    } else if (m_fluctuate) {
+      m_gain = mean * m_polya.Sample();
+    } else {
+      m_gain = std::exp(logGain);
+    }
+    return m_status != StatusCalculationAbandoned;
+  }
+
+  void GetEndPoint(double& x, double& y, double& z, double& t,
+                   int& status) const {
+    if (m_points.empty()) return;
+    x = m_points.back()[0];
+    y = m_points.back()[1];
+    z = m_points.back()[2];
+    t = m_points.back()[3];
+    status = m_status;
+  }
+  double GetGain() const { return m_gain; }
+  /// Townsend integral along the drift line.
+  double GetLogGain() const { return m_logGain; }
+  size_t GetNumberOfDriftLinePoints() const { return m_points.size(); }
+  void GetDriftLinePoint(const size_t i, double& x, double& y, double& z,
+                         double& t) const {
+    if (i >= m_points.size()) return;
+    x = m_points[i][0];
+    y = m_points[i][1];
+    z = m_points[i][2];
+    t = m_points[i][3];
+  }
+  /// Number of RKF steps taken for the last drift line.
+  unsigned int GetNumberOfSteps() const { return m_nSteps; }
+
+  static constexpr int StatusHitWire = -5;
+  static constexpr int StatusLeftDriftMedium = -1;
+  static constexpr int StatusCalculationAbandoned = -3;
+
+ private:
+  Garfield::Sensor* m_sensor = nullptr;
+  const RadialTable* m_table = nullptr;
+  const MagneticFieldMap* m_bfield = nullptr;
+  bool m_doSignal = true;
+  double m_accuracy = 1.e-6;
+  double m_maxStep = 0.05;
+  bool m_fluctuate = false;
+  PolyaSampler m_polya;
+  double m_meanGain = 0.;
+
+  std::vector<std::array<double, 4> > m_points;
+  double m_gain = 1.;
+  double m_logGain = 0.;
+  int m_status = 0;
+  unsigned int m_nSteps = 0;
+
+  static double Norm(const std::array<double, 3>& v) {
+    return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  }
+
+  bool Velocity(const std::array<double, 3>& x, std::array<double, 3>& v,
+                double& alpha) const {
+    double ex = 0., ey = 0., ez = 0.;
+    Garfield::Medium* medium = nullptr;
+    int status = 0;
+    m_sensor->ElectricField(x[0], x[1], x[2], ex, ey, ez, medium, status);
+    if (!medium || status != 0 || !medium->IsDriftable()) return false;
+    double bx = 0., by = 0., bz = 0.;
+    if (m_bfield) m_bfield->Field(x[0], x[1], x[2], bx, by, bz);
+    if (!medium->ElectronVelocity(ex, ey, ez, bx, by, bz, v[0], v[1], v[2])) {
+      return false;
+    }
+    double a = 0., eta = 0.;
+    medium->ElectronTownsend(ex, ey, ez, bx, by, bz, a);
+    medium->ElectronAttachment(ex, ey, ez, bx, by, bz, eta);
+    alpha = a - eta;
+    return true;
+  }
+
+  /// One Runge-Kutta-Fehlberg 4(5) step.
+  bool Step(const std::array<double, 3>& x0, const std::array<double, 3>& k1,
+            const double h, std::array<double, 3>& x1, double& err) const {
+    using namespace Rkf45;
+    std::array<double, 3> k2, k3, k4, k5, k6, y;
+    double a = 0.;
+    for (int i = 0; i < 3; ++i) y[i] = x0[i] + h * a21 * k1[i];
+    if (!Velocity(y, k2, a)) return false;
+    for (int i = 0; i < 3; ++i) y[i] = x0[i] + h * (a31 * k1[i] + a32 * k2[i]);
+    if (!Velocity(y, k3, a)) return false;
+    for (int i = 0; i < 3; ++i) {
+      y[i] = x0[i] + h * (a41 * k1[i] + a42 * k2[i] + a43 * k3[i]);
+    }
+    if (!Velocity(y, k4, a)) return false;
+    for (int i = 0; i < 3; ++i) {
+      y[i] = x0[i] +
+             h * (a51 * k1[i] + a52 * k2[i] + a53 * k3[i] + a54 * k4[i]);
+    }
+    if (!Velocity(y, k5, a)) return false;
+    for (int i = 0; i < 3; ++i) {
+      y[i] = x0[i] + h * (a61 * k1[i] + a62 * k2[i] + a63 * k3[i] +
+                          a64 * k4[i] + a65 * k5[i]);
+    }
+    if (!Velocity(y, k6, a)) return false;
+    double err2 = 0.;
+    for (int i = 0; i < 3; ++i) {
+      const double d4 = b1 * k1[i] + b3 * k3[i] + b4 * k4[i] + b5 * k5[i];
+      const double d5 =
+          c1 * k1[i] + c3 * k3[i] + c4 * k4[i] + c5 * k5[i] + c6 * k6[i];
+      x1[i] = x0[i] + h * d5;
+      err2 += h * h * (d5 - d4) * (d5 - d4);
+    }
+    err = std::sqrt(err2);
+    return true;
+  }
+};
+
+}  // namespace IdeaDch
+
+#endif
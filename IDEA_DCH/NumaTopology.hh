@@ -0,0 +1,160 @@
+#ifndef IDEA_DCH_NUMA_TOPOLOGY_HH
+#define IDEA_DCH_NUMA_TOPOLOGY_HH
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace IdeaDch {
+
+/// NUMA nodes of the machine and the cores of each node which this process
+/// may run on, from /sys/devices/system/node. Without NUMA information
+/// all allowed cores form a single node. Placement and memory binding use
+/// the system calls directly, so that libnuma is not needed.
+class NumaTopology {
+ public:
+  NumaTopology() { Discover(); }
+
+  size_t GetNumberOfNodes() const { return m_nodes.size(); }
+  size_t GetNumberOfCpus() const {
+    size_t n = 0;
+    for (const auto& node : m_nodes) n += node.cpus.size();
+    return n;
+  }
+  /// Operating system number of a node and its cores.
+  int GetNodeId(const size_t node) const { return m_nodes[node].id; }
+  const std::vector<int>& GetCpus(const size_t node) const {
+    return m_nodes[node].cpus;
+  }
+
+  /// Core and node index for each of n workers. Workers are spread over
+  /// the nodes in turn, so that memory bandwidth grows with the number of
+  /// workers; beyond the number of cores, cores are shared.
+  void Assign(const size_t n, std::vector<int>& cpus,
+              std::vector<size_t>& nodes) const {
+    cpus.clear();
+    nodes.clear();
+    std::vector<size_t> used(m_nodes.size(), 0);
+    size_t node = 0;
+    while (cpus.size() < n) {
+      // Next node with a free core; all full: start over.
+      size_t k = 0;
+      while (k < m_nodes.size() &&
+             used[node] >= m_nodes[node].cpus.size()) {
+        node = (node + 1) % m_nodes.size();
+        ++k;
+      }
+      if (k == m_nodes.size()) std::fill(used.begin(), used.end(), 0);
+      cpus.push_back(m_nodes[node].cpus[used[node]++]);
+      nodes.push_back(node);
+      node = (node + 1) % m_nodes.size();
+    }
+  }
+
+  /// Restrict the calling thread (or process) to one core.
+  static bool PinToCpu(const int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+  }
+
+  /// Restrict the calling thread to the cores of a node.
+  bool PinToNode(const size_t node) const {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : m_nodes[node].cpus) CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+  }
+
+  /// Allocate the pages the calling thread touches from now on from a
+  /// node, falling back to others when it is full. Pages already touched,
+  /// and pages shared copy-on-write with the parent process until written,
+  /// stay where they are.
+  bool PreferNode(const size_t node) const {
+    if (m_nodes.size() < 2) return true;
+    const int id = m_nodes[node].id;
+    constexpr size_t bits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(id / bits + 1, 0);
+    mask[id / bits] = 1UL << (id % bits);
+    return syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(),
+                   mask.size() * bits) == 0;
+  }
+
+  void Print() const {
+    std::cout << "NumaTopology: " << m_nodes.size() << " node(s), "
+              << GetNumberOfCpus() << " core(s)\n";
+    for (const auto& node : m_nodes) {
+      std::cout << "  node " << node.id << ":";
+      for (const int cpu : node.cpus) std::cout << " " << cpu;
+      std::cout << "\n";
+    }
+  }
+
+ private:
+  struct Node {
+    int id = 0;
+    std::vector<int> cpus;
+  };
+  std::vector<Node> m_nodes;
+
+  /// Parse a list like "0-3,8,10-11".
+  static std::vector<int> ParseList(const std::string& list) {
+    std::vector<int> values;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+      int a = 0, b = 0;
+      const int n = std::sscanf(item.c_str(), "%d-%d", &a, &b);
+      if (n < 1) continue;
+      if (n == 1) b = a;
+      for (int i = a; i <= b; ++i) values.push_back(i);
+    }
+    return values;
+  }
+
+  void Discover() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+      for (int i = 0; i < CPU_SETSIZE; ++i) CPU_SET(i, &allowed);
+    }
+    std::string online;
+    std::ifstream nodeList("/sys/devices/system/node/online");
+    if (nodeList) std::getline(nodeList, online);
+    for (const int id : ParseList(online)) {
+      std::ifstream cpuList("/sys/devices/system/node/node" +
+                            std::to_string(id) + "/cpulist");
+      std::string line;
+      if (!cpuList || !std::getline(cpuList, line)) continue;
+      Node node;
+      node.id = id;
+      for (const int cpu : ParseList(line)) {
+        if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+          node.cpus.push_back(cpu);
+        }
+      }
+      if (!node.cpus.empty()) m_nodes.push_back(node);
+    }
+    if (!m_nodes.empty()) return;
+    Node node;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &allowed)) node.cpus.push_back(cpu);
+    }
+    if (node.cpus.empty()) node.cpus.push_back(0);
+    m_nodes.push_back(node);
+  }
+};
+
+}  // namespace IdeaDch
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef IDEA_DCH_POLYA_SAMPLER_HH
+#define IDEA_DCH_POLYA_SAMPLER_HH
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "Math/DistFunc.h"
+
+#include "Garfield/Random.hh"
+
+namespace IdeaDch {
+
+/// Polya (gamma) distributed avalanche gains, sampled by table lookup.
+/// The distribution of G / <G> only depends on the shape parameter theta,
+/// so one inverse CDF table of the unit-mean distribution is built per theta
+/// and the mean gain is applied as a scale factor.
+class PolyaSampler {
+ public:
+  PolyaSampler() = default;
+  PolyaSampler(const double theta, const double mean, const size_t n = 4096) {
+    Build(theta, mean, n);
+  }
+
+  /// Tabulate the inverse CDF of the Polya distribution with shape
+  /// parameter theta at n equally probable points.
+  void Build(const double theta, const double mean, const size_t n = 4096) {
+    m_theta = theta;
+    m_mean = mean;
+    m_n = std::max<size_t>(n, 16);
+    const double k = theta + 1.;
+    m_q.resize(m_n + 1);
+    for (size_t i = 0; i < m_n; ++i) {
+      m_q[i] = ROOT::Math::gamma_quantile(double(i) / m_n, k, 1. / k);
+    }
+    // The last entry only serves as upper end of the interpolation.
+    m_q[m_n] = m_q[m_n - 1];
+    m_tailSlope = 1. / k;
+  }
+
+  bool IsReady() const { return !m_q.empty(); }
+  double GetTheta() const { return m_theta; }
+  double GetMean() const { return m_mean; }
+  void SetMean(const double mean) { m_mean = mean; }
+
+  /// Transform uniform random numbers u in [0, 1) into gains.
+  void Transform(const size_t n, const double* u, double* gain) const {
+    const double scale = m_mean;
+    const double nq = static_cast<double>(m_n);
+    for (size_t j = 0; j < n; ++j) {
+      const double v = u[j] * nq;
+      const size_t i = std::min(static_cast<size_t>(v), m_n - 1);
+      const double f = v - i;
+      gain[j] = scale * (m_q[i] + f * (m_q[i + 1] - m_q[i]));
+    }
+    // Beyond the last table point the tail is continued as an exponential
+    // with the asymptotic slope of the gamma distribution.
+    const double umax = 1. - 1. / nq;
+    for (size_t j = 0; j < n; ++j) {
+      if (u[j] < umax) continue;
+      const double w = std::max((1. - u[j]) * nq, 1.e-300);
+      gain[j] = scale * (m_q[m_n - 1] - m_tailSlope * std::log(w));
+    }
+  }
+
+  /// Sample one gain.
+  double Sample() const {
+    const double u = Garfield::RndmUniform();
+    double g = 0.;
+    Transform(1, &u, &g);
+    return g;
+  }
+
+  /// Sample n gains. The uniform numbers are drawn in blocks on the
+  /// stack, so the sampler itself is never written to.
+  void Sample(const size_t n, double* gain) const {
+    constexpr size_t block = 256;
+    double u[block];
+    for (size_t j0 = 0; j0 < n; j0 += block) {
+      const size_t m = std::min(block, n - j0);
+      for (size_t j = 0; j < m; ++j) u[j] = Garfield::RndmUniform();
+      Transform(m, u, gain + j0);
+    }
+  }
+
+  /// Compare mean, variance, skewness and the CDF of nSamples sampled gains
+  /// with the exact Polya distribution; false if any of the moments is
+  /// more than five standard errors off or the Kolmogorov-Smirnov distance
+  /// exceeds its 0.1% critical value.
+  bool Check(const size_t nSamples = 1000000) const {
+    std::vector<double> g(nSamples);
+    Sample(nSamples, g.data());
+    double s1 = 0., s2 = 0., s3 = 0.;
+    for (const auto x : g) s1 += x;
+    const double mean = s1 / nSamples;
+    for (const auto x : g) {
+      const double d = x - mean;
+      s2 += d * d;
+      s3 += d * d * d;
+    }
+    const double var = s2 / (nSamples - 1);
+    const double skew = (s3 / nSamples) / std::pow(s2 / nSamples, 1.5);
+    // Kolmogorov-Smirnov distance.
+    std::sort(g.begin(), g.end());
+    const double k = m_theta + 1.;
+    double dmax = 0.;
+    for (size_t i = 0; i < nSamples; ++i) {
+      const double f = ROOT::Math::gamma_cdf(g[i] / m_mean, k, 1. / k);
+      dmax = std::max({dmax, std::abs(f - double(i) / nSamples),
+                       std::abs(f - double(i + 1) / nSamples)});
+    }
+    const double expMean = m_mean;
+    const double expVar = m_mean * m_mean / k;
+    const double expSkew = 2. / std::sqrt(k);
+    // Standard errors of the sample mean and variance.
+    const double errMean = std::sqrt(expVar / nSamples);
+    const double kurt = 6. / k;
+    const double errVar = expVar * std::sqrt((2. + kurt) / nSamples);
+    // Asymptotic variance of the sample skewness, from the standardised
+    // central moments r3 ... r6 of the gamma distribution with shape k.
+    const double r3 = expSkew;
+    const double r4 = 3. + 6. / k;
+    const double r5 = (20. * k + 24.) / std::pow(k, 1.5);
+    const double r6 = 15. + 130. / k + 120. / (k * k);
+    const double errSkew = std::sqrt(
+        std::max(0., r6 - 3. * r3 * r5 - 6. * r4 + 2.25 * r3 * r3 * r4 +
+                         8.75 * r3 * r3 + 9.) / nSamples);
+    const double ksCrit = 1.95 / std::sqrt(nSamples);
+    const bool ok = std::abs(mean - expMean) < 5. * errMean &&
+                    std::abs(var - expVar) < 5. * errVar &&
+                    std::abs(skew - expSkew) < 5. * errSkew && dmax < ksCrit;
+    std::cout << "PolyaSampler::Check: theta = " << m_theta << ", "
+              << nSamples << " samples.\n"
+              << "    Mean:     " << mean << " (expected " << expMean << ")\n"
+              << "    Variance: " << var << " (expected " << expVar << ")\n"
+              << "    Skewness: " << skew << " (expected " << expSkew << ")\n"
+              << "    KS distance: " << dmax << " (0.1% critical value "
+              << ksCrit << ")\n"
+              << "    " << (ok ? "OK" : "FAILED") << "\n";
+    return ok;
+  }
+
+ private:
+  double m_theta = 0.;
+  double m_mean = 1.;
+  size_t m_n = 0;
+  double m_tailSlope = 1.;
+  // Quantiles of the unit-mean distribution.
+  std::vector<double> m_q;
+};
+
+}  // namespace IdeaDch
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef IDEA_DCH_RUN_CONFIG_HH
+#define IDEA_DCH_RUN_CONFIG_HH
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ChamberSetup.hh"
+
+namespace IdeaDch {
+
+/// Settings of one simulation run.
+struct RunConfig {
+  CellParameters cell;
+  std::string gasFile = "ar_93_co2_7_3bar.gas";
+  std::string ionMobility = "IonMobility_Ar+_Ar.txt";
+  // Operating pressure [Torr] and temperature [K] of the gas, by E/N
+  // scaling of the table; 0 means the conditions of the table.
+  double gasPressure = 0.;
+  double gasTemperature = 0.;
+  // Solenoid field along the wires [T], or a field map file.
+  double magneticField = 0.;
+  std::string magneticFieldMap = "";
+  std::string particle = "pi-";
+  double momentum = 10.e9;  // [eV/c]
+  // Signal time window (MDT-like).
+  double tmin = 0.;
+  double tstep = 2.0 / 3.0;
+  unsigned int nbins = 3000;
+  // Track start.
+  double x0 = -0.2;
+  double y0 = -1.0;
+  unsigned int nTracks = 1;
+  // Threads per stage of the event pipeline (if enabled).
+  unsigned int driftThreads = 4;
+  unsigned int signalThreads = 2;
+  unsigned int analysisThreads = 1;
+
+  /// Set a parameter by name. Returns false for unknown names or values
+  /// that cannot be parsed.
+  bool Set(const std::string& key, const std::string& value) {
+    try {
+      if (key == "cellSize") {
+        cell.cellSize = std::stod(value);
+      } else if (key == "senseWireRadius") {
+        cell.senseWireRadius = std::stod(value);
+      } else if (key == "fieldWireRadius") {
+        cell.fieldWireRadius = std::stod(value);
+      } else if (key == "senseVoltage") {
+        cell.senseVoltage = std::stod(value);
+      } else if (key == "fieldVoltage") {
+        cell.fieldVoltage = std::stod(value);
+      } else if (key == "boundaryVoltage") {
+        cell.boundaryVoltage = std::stod(value);
+      } else if (key == "boundaryFactor") {
+        cell.boundaryFactor = std::stod(value);
+      } else if (key == "gasFile") {
+        gasFile = value;
+      } else if (key == "ionMobility") {
+        ionMobility = value;
+      } else if (key == "gasPressure") {
+        gasPressure = std::stod(value);
+      } else if (key == "gasTemperature") {
+        gasTemperature = std::stod(value);
+      } else if (key == "magneticField") {
+        magneticField = std::stod(value);
+      } else if (key == "magneticFieldMap") {
+        magneticFieldMap = value;
+      } else if (key == "particle") {
+        particle = value;
+      } else if (key == "momentum") {
+        momentum = std::stod(value);
+      } else if (key == "tmin") {
+        tmin = std::stod(value);
+      } else if (key == "tstep") {
+        tstep = std::stod(value);
+      } else if (key == "nbins") {
+        nbins = std::stoul(value);
+      } else if (key == "x0") {
+        x0 = std::stod(value);
+      } else if (key == "y0") {
+        y0 = std::stod(value);
+      } else if (key == "nTracks") {
+        nTracks = std::stoul(value);
+      } else if (key == "driftThreads") {
+        driftThreads = std::stoul(value);
+      } else if (key == "signalThreads") {
+        signalThreads = std::stoul(value);
+      } else if (key == "analysisThreads") {
+        analysisThreads = std::stoul(value);
+      } else {
+        return false;
+      }
+    } catch (...) {
+      return false;
+    }
+    return true;
+  }
+
+  void Print() const {
+    std::cout << "  cell size " << cell.cellSize << " cm, wire radii "
+              << cell.senseWireRadius << "/" << cell.fieldWireRadius
+              << " cm, voltages " << cell.senseVoltage << "/"
+              << cell.fieldVoltage << " V, boundary " << cell.boundaryFactor
+              << "\n  gas " << gasFile;
+    if (gasPressure > 0.) std::cout << " at " << gasPressure << " Torr";
+    if (gasTemperature > 0.) std::cout << " at " << gasTemperature << " K";
+    std::cout << ", B ";
+    if (magneticFieldMap.empty()) {
+      std::cout << magneticField << " T";
+    } else {
+      std::cout << "from " << magneticFieldMap;
+    }
+    std::cout << "\n  " << particle << " at " << momentum << " eV/c, "
+              << nTracks << " track(s) from (" << x0 << ", " << y0
+              << ")\n  time window " << tmin << " + " << nbins << " x "
+              << tstep << " ns\n";
+  }
+};
+
+/// Split "key = value" or "--key=value" into key and value.
+inline bool splitOption(std::string line, std::string& key,
+                        std::string& value) {
+  const auto trim = [](std::string s) {
+    const auto a = s.find_first_not_of(" \t\r");
+    const auto b = s.find_last_not_of(" \t\r");
+    return a == std::string::npos ? std::string() : s.substr(a, b - a + 1);
+  };
+  if (line.rfind("--", 0) == 0) line = line.substr(2);
+  const auto eq = line.find('=');
+  if (eq == std::string::npos) return false;
+  key = trim(line.substr(0, eq));
+  value = trim(line.substr(eq + 1));
+  return !key.empty();
+}
+
+/// Read the runs of a configuration file. Lines are "key = value", with
+/// comments starting with '#'. Each line "[run]" starts a new run, which
+/// inherits the settings of the previous one; settings before the first
+/// "[run]" are common to all runs. A file without "[run]" is one run.
+inline bool readRunConfig(const std::string& filename, const RunConfig& base,
+                          std::vector<RunConfig>& runs) {
+  std::ifstream infile(filename);
+  if (!infile) {
+    std::cerr << "Could not open " << filename << ".\n";
+    return false;
+  }
+  RunConfig run = base;
+  bool inRun = false;
+  std::string line;
+  unsigned int lineNumber = 0;
+  while (std::getline(infile, line)) {
+    ++lineNumber;
+    line = line.substr(0, line.find('#'));
+    if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+    if (line.find("[run]") != std::string::npos) {
+      if (inRun) runs.push_back(run);
+      inRun = true;
+      continue;
+    }
+    std::string key, value;
+    if (!splitOption(line, key, value) || !run.Set(key, value)) {
+      std::cerr << filename << ":" << lineNumber << ": cannot parse \""
+                << line << "\".\n";
+      return false;
+    }
+  }
+  if (inRun || runs.empty()) runs.push_back(run);
+  return true;
+}
+
+/// Runs from the command line: an optional configuration file followed by
+/// --key=value options, which apply to every run.
+inline bool parseRunConfig(int argc, char* argv[],
+                           std::vector<RunConfig>& runs) {
+  std::string filename;
+  std::vector<std::pair<std::string, std::string> > overrides;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    std::string key, value;
+    if (arg.rfind("--", 0) == 0 && splitOption(arg, key, value)) {
+      overrides.emplace_back(key, value);
+    } else if (arg.rfind("-", 0) != 0 && filename.empty()) {
+      filename = arg;
+    } else {
+      std::cerr << "Unknown option " << arg << ".\n";
+      return false;
+    }
+  }
+  runs.clear();
+  if (filename.empty()) {
+    runs.emplace_back();
+  } else if (!readRunConfig(filename, RunConfig(), runs)) {
+    return false;
+  }
+  for (auto& run : runs) {
+    for (const auto& option : overrides) {
+      if (run.Set(option.first, option.second)) continue;
+      std::cerr << "Unknown option --" << option.first << ".\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace IdeaDch
+
+#endif
@@ -0,0 +1,257 @@
+#ifndef IDEA_DCH_SUPERPOSED_FIELD_HH
+#define IDEA_DCH_SUPERPOSED_FIELD_HH
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Garfield/ComponentAnalyticField.hh"
+#include "Garfield/Medium.hh"
+
+#include "ChamberSetup.hh"
+
+namespace IdeaDch {
+
+/// Electrostatic field of the drift cell for arbitrary sense wire, field
+/// wire and boundary plane potentials. The field is linear in the
+/// potentials, so the cell is solved once per conductor group at unit
+/// potential (others grounded), and a voltage setting is the weighted sum
+/// of the three unit solutions. The unit solutions are tabulated on a
+/// grid; close to the wires, where the grid cannot follow the 1 / r field,
+/// the analytic unit fields are summed instead.
+class SuperposedField : public Garfield::Component {
+ public:
+  enum Group { Sense = 0, Field, Boundary, NumberOfGroups };
+
+  SuperposedField() : Garfield::Component("SuperposedField") {}
+
+  /// Solve the unit cells and tabulate their fields on nGrid x nGrid nodes
+  /// spanning the boundary box. The grid is not used within nearWire grid
+  /// spacings of a wire.
+  bool Build(Garfield::Medium* medium, const CellParameters& cell,
+             const unsigned int nGrid = 512, const double nearWire = 8.) {
+    if (!medium || nGrid < 2) return false;
+    m_medium = medium;
+    for (unsigned int g = 0; g < NumberOfGroups; ++g) {
+      CellParameters unit = cell;
+      unit.senseVoltage = g == Sense ? 1. : 0.;
+      unit.fieldVoltage = g == Field ? 1. : 0.;
+      unit.boundaryVoltage = g == Boundary ? 1. : 0.;
+      m_unit[g] = std::make_unique<Garfield::ComponentAnalyticField>();
+      m_unit[g]->SetMedium(medium);
+      BuildCell(*m_unit[g], unit);
+    }
+    m_wires = FieldWirePositions(cell);
+    m_wires.insert(m_wires.begin(), {0., 0.});
+    const double boundary = cell.boundaryFactor * cell.cellSize;
+    m_n = nGrid;
+    m_x0 = -boundary;
+    m_h = 2. * boundary / (nGrid - 1);
+    m_rNear = nearWire * m_h;
+    // Tabulate the unit fields.
+    for (unsigned int g = 0; g < NumberOfGroups; ++g) {
+      m_maps[g].assign(size_t(m_n) * m_n, {0., 0., 0.});
+    }
+    for (unsigned int j = 0; j < m_n; ++j) {
+      const double y = m_x0 + j * m_h;
+      for (unsigned int i = 0; i < m_n; ++i) {
+        const double x = m_x0 + i * m_h;
+        if (NearWire(x, y, 0.)) continue;
+        for (unsigned int g = 0; g < NumberOfGroups; ++g) {
+          double ex = 0., ey = 0., ez = 0., v = 0.;
+          Garfield::Medium* m = nullptr;
+          int status = 0;
+          m_unit[g]->ElectricField(x, y, 0., ex, ey, ez, v, m, status);
+          m_maps[g][Index(i, j)] = {ex, ey, v};
+        }
+      }
+    }
+    // Grid cells which are interpolated: all corners away from the wires.
+    m_far.assign(size_t(m_n - 1) * (m_n - 1), 0);
+    for (unsigned int j = 0; j + 1 < m_n; ++j) {
+      for (unsigned int i = 0; i + 1 < m_n; ++i) {
+        const double x = m_x0 + (i + 0.5) * m_h;
+        const double y = m_x0 + (j + 0.5) * m_h;
+        m_far[j * (m_n - 1) + i] = !NearWire(x, y, m_h);
+      }
+    }
+    std::cout << "SuperposedField::Build: " << m_n << " x " << m_n
+              << " nodes, spacing " << m_h * 1.e4 << " um, analytic within "
+              << m_rNear * 1.e4 << " um of the wires.\n";
+    SetVoltages(cell.senseVoltage, cell.fieldVoltage, cell.boundaryVoltage);
+    return true;
+  }
+
+  bool IsReady() const { return !m_map.empty(); }
+
+  /// Combine the unit solutions for the given potentials.
+  void SetVoltages(const double vSense, const double vField,
+                   const double vBoundary) {
+    m_v = {vSense, vField, vBoundary};
+    m_map.resize(m_maps[Sense].size());
+    for (size_t k = 0; k < m_map.size(); ++k) {
+      for (unsigned int c = 0; c < 3; ++c) {
+        m_map[k][c] = vSense * m_maps[Sense][k][c] +
+                      vField * m_maps[Field][k][c] +
+                      vBoundary * m_maps[Boundary][k][c];
+      }
+    }
+  }
+  const std::array<double, NumberOfGroups>& GetVoltages() const { return m_v; }
+
+  Garfield::Medium* GetMedium(const double x, const double y,
+                              const double z) override {
+    return m_unit[Sense] ? m_unit[Sense]->GetMedium(x, y, z) : nullptr;
+  }
+
+  void ElectricField(const double x, const double y, const double z,
+                     double& ex, double& ey, double& ez, double& v,
+                     Garfield::Medium*& m, int& status) override {
+    ez = 0.;
+    status = 0;
+    m = nullptr;
+    if (Interpolate(m_map, x, y, ex, ey, v)) {
+      m = m_medium;
+      return;
+    }
+    ex = ey = v = 0.;
+    for (unsigned int g = 0; g < NumberOfGroups; ++g) {
+      double gx = 0., gy = 0., gz = 0., gv = 0.;
+      m_unit[g]->ElectricField(x, y, z, gx, gy, gz, gv, m, status);
+      ex += m_v[g] * gx;
+      ey += m_v[g] * gy;
+      ez += m_v[g] * gz;
+      v += m_v[g] * gv;
+    }
+  }
+
+  void ElectricField(const double x, const double y, const double z,
+                     double& ex, double& ey, double& ez, Garfield::Medium*& m,
+                     int& status) override {
+    double v = 0.;
+    ElectricField(x, y, z, ex, ey, ez, v, m, status);
+  }
+
+  bool GetVoltageRange(double& vmin, double& vmax) override {
+    vmin = std::min({m_v[0], m_v[1], m_v[2]});
+    vmax = std::max({m_v[0], m_v[1], m_v[2]});
+    return true;
+  }
+
+  /// The weighting field of the sense wire is its unit field.
+  void WeightingField(const double x, const double y, const double z,
+                      double& wx, double& wy, double& wz,
+                      const std::string& label) override {
+    wx = wy = wz = 0.;
+    if (label != "s" || !m_unit[Sense]) return;
+    double v = 0.;
+    if (Interpolate(m_maps[Sense], x, y, wx, wy, v)) return;
+    m_unit[Sense]->WeightingField(x, y, z, wx, wy, wz, label);
+  }
+
+  double WeightingPotential(const double x, const double y, const double z,
+                            const std::string& label) override {
+    if (label != "s" || !m_unit[Sense]) return 0.;
+    double wx = 0., wy = 0., v = 0.;
+    if (Interpolate(m_maps[Sense], x, y, wx, wy, v)) return v;
+    return m_unit[Sense]->WeightingPotential(x, y, z, label);
+  }
+
+  bool GetBoundingBox(double& x0, double& y0, double& z0, double& x1,
+                      double& y1, double& z1) override {
+    if (!m_unit[Sense]) return false;
+    return m_unit[Sense]->GetBoundingBox(x0, y0, z0, x1, y1, z1);
+  }
+
+  // The wire geometry is the same in all unit cells.
+  bool IsWireCrossed(const double x0, const double y0, const double z0,
+                     const double x1, const double y1, const double z1,
+                     double& xc, double& yc, double& zc, const bool centre,
+                     double& rc) override {
+    if (!m_unit[Sense]) return false;
+    return m_unit[Sense]->IsWireCrossed(x0, y0, z0, x1, y1, z1, xc, yc, zc,
+                                        centre, rc);
+  }
+
+  bool IsInTrapRadius(const double q0, const double x0, const double y0,
+                      const double z0, double& xw, double& yw,
+                      double& rw) override {
+    if (!m_unit[Sense]) return false;
+    return m_unit[Sense]->IsInTrapRadius(q0, x0, y0, z0, xw, yw, rw);
+  }
+
+ protected:
+  void Reset() override {
+    for (auto& unit : m_unit) unit.reset();
+    for (auto& map : m_maps) map.clear();
+    m_map.clear();
+    m_far.clear();
+  }
+  void UpdatePeriodicity() override {}
+
+ private:
+  Garfield::Medium* m_medium = nullptr;
+  std::array<std::unique_ptr<Garfield::ComponentAnalyticField>,
+             NumberOfGroups> m_unit;
+  std::vector<std::pair<double, double> > m_wires;
+  std::array<double, NumberOfGroups> m_v = {0., 0., 0.};
+
+  // Grid: m_n x m_n nodes from m_x0 with spacing m_h in x and y.
+  unsigned int m_n = 0;
+  double m_x0 = 0.;
+  double m_h = 1.;
+  double m_rNear = 0.;
+  // Ex, Ey, V per node of the unit solutions and of the current setting.
+  std::array<std::vector<std::array<double, 3> >, NumberOfGroups> m_maps;
+  std::vector<std::array<double, 3> > m_map;
+  std::vector<char> m_far;
+
+  size_t Index(const unsigned int i, const unsigned int j) const {
+    return size_t(j) * m_n + i;
+  }
+
+  bool NearWire(const double x, const double y, const double margin) const {
+    const double r = m_rNear + margin;
+    for (const auto& w : m_wires) {
+      const double dx = x - w.first, dy = y - w.second;
+      if (dx * dx + dy * dy < r * r) return true;
+    }
+    return false;
+  }
+
+  /// Bilinear interpolation in a map; false if (x, y) is not in a grid cell
+  /// away from the wires.
+  bool Interpolate(const std::vector<std::array<double, 3> >& map,
+                   const double x, const double y, double& ex, double& ey,
+                   double& v) const {
+    if (map.empty()) return false;
+    const double u = (x - m_x0) / m_h;
+    const double w = (y - m_x0) / m_h;
+    if (u < 0. || w < 0. || u >= m_n - 1 || w >= m_n - 1) return false;
+    const unsigned int i = static_cast<unsigned int>(u);
+    const unsigned int j = static_cast<unsigned int>(w);
+    if (!m_far[j * (m_n - 1) + i]) return false;
+    const double fx = u - i, fy = w - j;
+    const auto& a = map[Index(i, j)];
+    const auto& b = map[Index(i + 1, j)];
+    const auto& c = map[Index(i, j + 1)];
+    const auto& d = map[Index(i + 1, j + 1)];
+    double f[3];
+    for (unsigned int k = 0; k < 3; ++k) {
+      f[k] = (1. - fy) * ((1. - fx) * a[k] + fx * b[k]) +
+             fy * ((1. - fx) * c[k] + fx * d[k]);
+    }
+    ex = f[0];
+    ey = f[1];
+    v = f[2];
+    return true;
+  }
+};
+
+}  // namespace IdeaDch
+
+#endif
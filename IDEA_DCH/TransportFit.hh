@@ -0,0 +1,190 @@
+#ifndef IDEA_DCH_TRANSPORT_FIT_HH
+#define IDEA_DCH_TRANSPORT_FIT_HH
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "Garfield/Medium.hh"
+
+namespace IdeaDch {
+
+/// Piecewise Chebyshev approximation of a function of x on [xmin, xmax],
+/// with pieces of equal width. Evaluation is an index computation and a
+/// Clenshaw recurrence, i.e. a few multiply-adds per point. The source is
+/// typically an interpolated table with kinks at its nodes, so the error
+/// is checked on a dense grid rather than only between the fit nodes.
+/// The degree is a template parameter so that the recurrence is unrolled.
+template <unsigned int Degree>
+class PiecewiseChebyshev {
+ public:
+  /// Fit f, doubling the number of pieces
+  /// until |fit - f| <= tolerance * max(|f|, floor) at nTest points
+  /// (and at least 16 per piece), or until maxPieces is reached.
+  bool Fit(const std::function<double(double)>& f, const double xmin,
+           const double xmax, const double tolerance, const double floor,
+           const unsigned int maxPieces = 512,
+           const unsigned int nTest = 4096) {
+    if (xmax <= xmin) return false;
+    m_xmin = xmin;
+    for (unsigned int nPieces = 2; nPieces <= maxPieces; nPieces *= 2) {
+      m_width = (xmax - xmin) / nPieces;
+      m_invWidth = 1. / m_width;
+      m_nPieces = nPieces;
+      m_c.assign(size_t(nPieces) * m_n, 0.);
+      double fk[m_n];
+      for (unsigned int p = 0; p < nPieces; ++p) {
+        const double a = xmin + p * m_width;
+        for (unsigned int k = 0; k < m_n; ++k) {
+          const double t = std::cos(M_PI * (k + 0.5) / m_n);
+          fk[k] = f(a + 0.5 * (t + 1.) * m_width);
+        }
+        double* c = &m_c[size_t(p) * m_n];
+        for (unsigned int j = 0; j < m_n; ++j) {
+          double sum = 0.;
+          for (unsigned int k = 0; k < m_n; ++k) {
+            sum += fk[k] * std::cos(M_PI * j * (k + 0.5) / m_n);
+          }
+          c[j] = (j == 0 ? 1. : 2.) * sum / m_n;
+        }
+      }
+      const unsigned int nCheck = std::max(nTest, 16 * nPieces);
+      m_maxError = 0.;
+      m_maxAbsError = 0.;
+      for (unsigned int i = 0; i < nCheck; ++i) {
+        const double x = xmin + (i + 0.5) * (xmax - xmin) / nCheck;
+        const double y = f(x);
+        const double d = std::abs(Evaluate(x) - y);
+        m_maxAbsError = std::max(m_maxAbsError, d);
+        m_maxError = std::max(m_maxError, d / std::max(std::abs(y), floor));
+      }
+      if (m_maxError <= tolerance) return true;
+    }
+    return false;
+  }
+
+  double Evaluate(const double x) const {
+    const double u = std::clamp((x - m_xmin) * m_invWidth, 0.,
+                                m_nPieces - 1.e-9);
+    const unsigned int p = static_cast<unsigned int>(u);
+    const double t = 2. * (u - p) - 1.;
+    const double* c = &m_c[size_t(p) * m_n];
+    // Clenshaw recurrence.
+    const double t2 = 2. * t;
+    double b1 = 0., b2 = 0.;
+    for (unsigned int j = Degree; j > 0; --j) {
+      const double b0 = t2 * b1 - b2 + c[j];
+      b2 = b1;
+      b1 = b0;
+    }
+    return t * b1 - b2 + c[0];
+  }
+
+  unsigned int GetNumberOfPieces() const { return m_nPieces; }
+  unsigned int GetNumberOfCoefficients() const { return m_c.size(); }
+  /// Largest deviation found in the fit, relative (with the floor) and
+  /// absolute.
+  double GetMaxError() const { return m_maxError; }
+  double GetMaxAbsError() const { return m_maxAbsError; }
+
+ private:
+  double m_xmin = 0.;
+  double m_width = 1.;
+  double m_invWidth = 1.;
+  unsigned int m_nPieces = 0;
+  static constexpr unsigned int m_n = Degree + 1;
+  std::vector<double> m_c;
+  double m_maxError = 0.;
+  double m_maxAbsError = 0.;
+};
+
+/// Drift speed, alpha - eta and diffusion coefficients of a medium as
+/// piecewise Chebyshev fits in log |E|, as an alternative to the
+/// resampled ElectronTransportTable. Assumes B = 0; the field is clamped
+/// to the range of the fit.
+class TransportFit {
+ public:
+  static constexpr unsigned int Degree = 5;
+  using Fit = PiecewiseChebyshev<Degree>;
+
+  /// Fit the curves over [emin, emax] (normally the field range of the
+  /// gas table). Returns false, and leaves the fit unusable, if any curve
+  /// misses the tolerance.
+  bool Build(Garfield::Medium& medium, const double emin, const double emax,
+             const double tolerance = 1.e-3) {
+    m_ready = false;
+    if (emin <= 0. || emax <= emin) return false;
+    auto velocity = [&medium](const double x) {
+      double vx = 0., vy = 0., vz = 0.;
+      medium.ElectronVelocity(std::exp(x), 0., 0., 0., 0., 0., vx, vy, vz);
+      return std::sqrt(vx * vx + vy * vy + vz * vz);
+    };
+    auto alpha = [&medium](const double x) {
+      double a = 0., eta = 0.;
+      medium.ElectronTownsend(std::exp(x), 0., 0., 0., 0., 0., a);
+      medium.ElectronAttachment(std::exp(x), 0., 0., 0., 0., 0., eta);
+      return a - eta;
+    };
+    auto diffusion = [&medium](const double x, const bool longitudinal) {
+      double dl = 0., dt = 0.;
+      medium.ElectronDiffusion(std::exp(x), 0., 0., 0., 0., 0., dl, dt);
+      return longitudinal ? dl : dt;
+    };
+    const double x0 = std::log(emin), x1 = std::log(emax);
+    // Townsend coefficients are compared with at least 1 / cm.
+    const bool ok[4] = {
+        m_speed.Fit(velocity, x0, x1, tolerance, 1.e-9),
+        m_alpha.Fit(alpha, x0, x1, tolerance, 1.),
+        m_dl.Fit([&](double x) { return diffusion(x, true); }, x0, x1,
+                 tolerance, 1.e-9),
+        m_dt.Fit([&](double x) { return diffusion(x, false); }, x0, x1,
+                 tolerance, 1.e-9)};
+    const char* names[4] = {"velocity", "alpha - eta", "DL", "DT"};
+    const Fit* fits[4] = {&m_speed, &m_alpha, &m_dl, &m_dt};
+    for (int i = 0; i < 4; ++i) {
+      std::cout << "TransportFit::Build: " << names[i] << ": "
+                << fits[i]->GetNumberOfPieces() << " pieces, max. deviation "
+                << 100. * fits[i]->GetMaxError() << "%"
+                << (ok[i] ? "" : " (tolerance not reached)") << ".\n";
+    }
+    m_ready = ok[0] && ok[1] && ok[2] && ok[3];
+    return m_ready;
+  }
+
+  bool IsReady() const { return m_ready; }
+  const Fit& GetSpeedFit() const { return m_speed; }
+  const Fit& GetAlphaFit() const { return m_alpha; }
+  const Fit& GetLongitudinalDiffusionFit() const { return m_dl; }
+  const Fit& GetTransverseDiffusionFit() const { return m_dt; }
+
+  /// Drift speed [cm/ns] and alpha - eta [1/cm] at n field magnitudes,
+  /// same interface as ElectronTransportTable::Evaluate.
+  void Evaluate(const size_t n, const double* emag, double* speed,
+                double* alpha) const {
+    for (size_t j = 0; j < n; ++j) {
+      const double x = std::log(std::max(emag[j], 1.e-10));
+      speed[j] = m_speed.Evaluate(x);
+      alpha[j] = m_alpha.Evaluate(x);
+    }
+  }
+
+  /// Longitudinal and transverse diffusion [cm1/2] at n field magnitudes.
+  void Diffusion(const size_t n, const double* emag, double* dl,
+                 double* dt) const {
+    for (size_t j = 0; j < n; ++j) {
+      const double x = std::log(std::max(emag[j], 1.e-10));
+      dl[j] = m_dl.Evaluate(x);
+      dt[j] = m_dt.Evaluate(x);
+    }
+  }
+
+ private:
+  Fit m_speed, m_alpha, m_dl, m_dt;
+  bool m_ready = false;
+};
+
+}  // namespace IdeaDch
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef IDEA_DCH_TRANSPORT_TABLE_HH
+#define IDEA_DCH_TRANSPORT_TABLE_HH
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include "Garfield/Medium.hh"
+
+namespace IdeaDch {
+
+/// Electron drift speed and effective Townsend coefficient (alpha - eta)
+/// as function of |E|, resampled from a medium on a uniform grid in log |E|
+/// so that a lookup is an index computation and one linear interpolation.
+/// Assumes B = 0, i.e. the drift velocity is anti-parallel to E.
+class ElectronTransportTable {
+ public:
+  bool Build(Garfield::Medium& medium, const double emin = 10.,
+             const double emax = 1.e6, const unsigned int n = 1024) {
+    if (emin <= 0. || emax <= emin || n < 2) return false;
+    m_lemin = std::log(emin);
+    m_dle = (std::log(emax) - m_lemin) / (n - 1);
+    m_speed.assign(n, 0.);
+    m_alpha.assign(n, 0.);
+    for (unsigned int i = 0; i < n; ++i) {
+      const double e = std::exp(m_lemin + i * m_dle);
+      double vx = 0., vy = 0., vz = 0.;
+      if (!medium.ElectronVelocity(e, 0., 0., 0., 0., 0., vx, vy, vz)) {
+        return false;
+      }
+      m_speed[i] = std::sqrt(vx * vx + vy * vy + vz * vz);
+      double a = 0., eta = 0.;
+      medium.ElectronTownsend(e, 0., 0., 0., 0., 0., a);
+      medium.ElectronAttachment(e, 0., 0., 0., 0., 0., eta);
+      m_alpha[i] = a - eta;
+    }
+    return true;
+  }
+
+  bool IsReady() const { return !m_speed.empty(); }
+
+  /// Drift speed [cm/ns] and alpha - eta [1/cm] at n field magnitudes.
+  void Evaluate(const size_t n, const double* emag, double* speed,
+                double* alpha) const {
+    const double imax = m_speed.size() - 1.000001;
+    for (size_t j = 0; j < n; ++j) {
+      const double u = std::clamp(
+          (std::log(std::max(emag[j], 1.e-10)) - m_lemin) / m_dle, 0., imax);
+      const size_t i = static_cast<size_t>(u);
+      const double f = u - i;
+      speed[j] = m_speed[i] + f * (m_speed[i + 1] - m_speed[i]);
+      alpha[j] = m_alpha[i] + f * (m_alpha[i + 1] - m_alpha[i]);
+    }
+  }
+
+ private:
+  double m_lemin = 0.;
+  double m_dle = 1.;
+  std::vector<double> m_speed;
+  std::vector<double> m_alpha;
+};
+
+/// Electron drift velocity and alpha - eta as function of |E|, |B| and the
+/// angle between E and B, resampled from a medium (normally a gas table
+/// generated with B and angle dimensions) on a uniform grid in log |E|,
+/// |B| and angle. The velocity is stored in the frame of the fields:
+/// along E, along the component of B transverse to E, and along E x B.
+/// A lookup is a frame construction and one trilinear interpolation.
+class MagnetisedTransportTable {
+ public:
+  bool Build(Garfield::Medium& medium, const double bmax,
+             const unsigned int nB = 5, const unsigned int nAngle = 10,
+             const double emin = 10., const double emax = 1.e6,
+             const unsigned int nE = 256) {
+    if (emin <= 0. || emax <= emin || nE < 2 || nB < 2 || nAngle < 2 ||
+        bmax <= 0.) {
+      return false;
+    }
+    m_lemin = std::log(emin);
+    m_dle = (std::log(emax) - m_lemin) / (nE - 1);
+    m_db = bmax / (nB - 1);
+    m_da = M_PI / (nAngle - 1);
+    m_nE = nE;
+    m_nB = nB;
+    m_nA = nAngle;
+    m_nodes.assign(size_t(nE) * nB * nAngle, {0., 0., 0., 0.});
+    // E along x, B in the x-y plane: vx is along E, vy along the
+    // transverse component of B and vz along E x B.
+    for (unsigned int k = 0; k < nAngle; ++k) {
+      const double c = std::cos(k * m_da), s = std::sin(k * m_da);
+      for (unsigned int j = 0; j < nB; ++j) {
+        const double b = j * m_db;
+        for (unsigned int i = 0; i < nE; ++i) {
+          const double e = std::exp(m_lemin + i * m_dle);
+          auto& node = m_nodes[Index(i, j, k)];
+          if (!medium.ElectronVelocity(e, 0., 0., b * c, b * s, 0., node[0],
+                                       node[1], node[2])) {
+            return false;
+          }
+          double a = 0., eta = 0.;
+          medium.ElectronTownsend(e, 0., 0., b * c, b * s, 0., a);
+          medium.ElectronAttachment(e, 0., 0., b * c, b * s, 0., eta);
+          node[3] = a - eta;
+        }
+      }
+    }
+    return true;
+  }
+
+  bool IsReady() const { return !m_nodes.empty(); }
+  double GetMaximumField() const { return (m_nB - 1) * m_db; }
+
+  /// Angle between the drift velocity and -E [rad] for |E| [V/cm] and a
+  /// field |B| [T] perpendicular to it.
+  double LorentzAngle(const double e, const double b) const {
+    const double ex = e, zero = 0., by = b;
+    double vx = 0., vy = 0., vz = 0., a = 0.;
+    Evaluate(1, &ex, &zero, &zero, &zero, &by, &zero, &vx, &vy, &vz, &a);
+    return std::atan2(std::hypot(vy, vz), -vx);
+  }
+
+  /// Drift velocity [cm/ns] and alpha - eta [1/cm] at n points with
+  /// fields (ex, ey, ez) [V/cm] and (bx, by, bz) [T].
+  void Evaluate(const size_t n, const double* ex, const double* ey,
+                const double* ez, const double* bx, const double* by,
+                const double* bz, double* vx, double* vy, double* vz,
+                double* alpha) const {
+    const double imax = m_nE - 1.000001;
+    const double jmax = m_nB - 1.000001;
+    const double kmax = m_nA - 1.000001;
+    for (size_t l = 0; l < n; ++l) {
+      // Frame: e1 along E, e2 along the transverse part of B, e3 = e1 x e2.
+      const double emag =
+          std::sqrt(ex[l] * ex[l] + ey[l] * ey[l] + ez[l] * ez[l]);
+      const double e1[3] = {emag > 0. ? ex[l] / emag : 1.,
+                            emag > 0. ? ey[l] / emag : 0.,
+                            emag > 0. ? ez[l] / emag : 0.};
+      const double bl = e1[0] * bx[l] + e1[1] * by[l] + e1[2] * bz[l];
+      double e2[3] = {bx[l] - bl * e1[0], by[l] - bl * e1[1],
+                      bz[l] - bl * e1[2]};
+      const double bt = std::sqrt(e2[0] * e2[0] + e2[1] * e2[1] +
+                                  e2[2] * e2[2]);
+      if (bt > 1.e-9) {
+        for (auto& c : e2) c /= bt;
+      } else {
+        // B (anti-)parallel to E: any direction perpendicular to E.
+        const bool useX = std::abs(e1[0]) < 0.9;
+        e2[0] = useX ? 0. : -e1[1];
+        e2[1] = useX ? e1[2] : e1[0];
+        e2[2] = useX ? -e1[1] : 0.;
+        const double norm = std::sqrt(e2[0] * e2[0] + e2[1] * e2[1] +
+                                      e2[2] * e2[2]);
+        for (auto& c : e2) c /= norm;
+      }
+      const double e3[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                            e1[2] * e2[0] - e1[0] * e2[2],
+                            e1[0] * e2[1] - e1[1] * e2[0]};
+      // Grid coordinates.
+      const double u = std::clamp(
+          (std::log(std::max(emag, 1.e-10)) - m_lemin) / m_dle, 0., imax);
+      const double v = std::clamp(std::hypot(bl, bt) / m_db, 0., jmax);
+      const double w = std::clamp(std::atan2(bt, bl) / m_da, 0., kmax);
+      const size_t i = static_cast<size_t>(u);
+      const size_t j = static_cast<size_t>(v);
+      const size_t k = static_cast<size_t>(w);
+      const double fu = u - i, fv = v - j, fw = w - k;
+      double q[4] = {0., 0., 0., 0.};
+      for (int c = 0; c < 8; ++c) {
+        const int di = c & 1, dj = (c >> 1) & 1, dk = (c >> 2) & 1;
+        const double f = (di ? fu : 1. - fu) * (dj ? fv : 1. - fv) *
+                         (dk ? fw : 1. - fw);
+        const auto& node = m_nodes[Index(i + di, j + dj, k + dk)];
+        for (int m = 0; m < 4; ++m) q[m] += f * node[m];
+      }
+      vx[l] = q[0] * e1[0] + q[1] * e2[0] + q[2] * e3[0];
+      vy[l] = q[0] * e1[1] + q[1] * e2[1] + q[2] * e3[1];
+      vz[l] = q[0] * e1[2] + q[1] * e2[2] + q[2] * e3[2];
+      alpha[l] = q[3];
+    }
+  }
+
+ private:
+  double m_lemin = 0.;
+  double m_dle = 1.;
+  double m_db = 1.;
+  double m_da = 1.;
+  unsigned int m_nE = 0, m_nB = 0, m_nA = 0;
+  // Velocity along E, B transverse and E x B, and alpha - eta per node,
+  // with log |E| running fastest.
+  std::vector<std::array<double, 4> > m_nodes;
+
+  size_t Index(const size_t i, const size_t j, const size_t k) const {
+    return i + m_nE * (j + m_nB * k);
+  }
+};
+
+}  // namespace IdeaDch
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef IDEA_DCH_WAVEFORM_LIBRARY_HH
+#define IDEA_DCH_WAVEFORM_LIBRARY_HH
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Garfield/Random.hh"
+
+namespace IdeaDch {
+
+/// Layout of a waveform library file: header, samples of all waveforms
+/// (float, only the non-zero part of each), zero padding up to the
+/// alignment of the index entries, index.
+struct WaveformLibraryHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t nbins;
+  double tmin;
+  double tstep;
+  uint64_t nWaveforms;
+  uint64_t indexOffset;  // [bytes]
+};
+
+struct WaveformLibraryEntry {
+  uint64_t offset;  // first sample, counted in floats from the data start
+  uint32_t first;   // bin of the first stored sample
+  uint32_t length;  // number of stored samples
+};
+
+constexpr char waveformLibraryMagic[8] = {'I', 'D', 'E', 'A',
+                                          'W', 'F', 'L', '1'};
+
+/// Collects single-track waveforms and writes them to a library file.
+class WaveformLibraryWriter {
+ public:
+  WaveformLibraryWriter(const double tmin, const double tstep,
+                        const unsigned int nbins)
+      : m_tmin(tmin), m_tstep(tstep), m_nbins(nbins) {}
+
+  /// Add a waveform of nbins bins; leading and trailing samples with
+  /// magnitude below threshold are dropped.
+  void Add(const double* w, const double threshold = 1.e-6) {
+    unsigned int first = 0, last = m_nbins;
+    while (first < last && std::abs(w[first]) < threshold) ++first;
+    while (last > first && std::abs(w[last - 1]) < threshold) --last;
+    m_index.push_back({m_data.size(), first, last - first});
+    m_data.insert(m_data.end(), w + first, w + last);
+  }
+  size_t GetNumberOfWaveforms() const { return m_index.size(); }
+
+  bool Write(const std::string& filename) const {
+    std::ofstream outfile(filename, std::ios::binary | std::ios::trunc);
+    if (!outfile) {
+      std::cerr << "WaveformLibraryWriter::Write: Could not open " << filename
+                << ".\n";
+      return false;
+    }
+    WaveformLibraryHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, waveformLibraryMagic, sizeof(header.magic));
+    header.version = 1;
+    header.nbins = m_nbins;
+    header.tmin = m_tmin;
+    header.tstep = m_tstep;
+    header.nWaveforms = m_index.size();
+    const size_t dataEnd = sizeof(header) + m_data.size() * sizeof(float);
+    constexpr size_t align = alignof(WaveformLibraryEntry);
+    header.indexOffset = (dataEnd + align - 1) / align * align;
+    outfile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    outfile.write(reinterpret_cast<const char*>(m_data.data()),
+                  m_data.size() * sizeof(float));
+    const char padding[align] = {};
+    outfile.write(padding, header.indexOffset - dataEnd);
+    outfile.write(reinterpret_cast<const char*>(m_index.data()),
+                  m_index.size() * sizeof(WaveformLibraryEntry));
+    return bool(outfile);
+  }
+
+ private:
+  double m_tmin, m_tstep;
+  unsigned int m_nbins;
+  std::vector<float> m_data;
+  std::vector<WaveformLibraryEntry> m_index;
+};
+
+/// Read-only, memory-mapped waveform library. Waveforms are used in place;
+/// only the pages of the waveforms actually overlaid are read from disk.
+class WaveformLibrary {
+ public:
+  WaveformLibrary() = default;
+  ~WaveformLibrary() { Close(); }
+  WaveformLibrary(const WaveformLibrary&) = delete;
+  WaveformLibrary& operator=(const WaveformLibrary&) = delete;
+
+  bool Open(const std::string& filename) {
+    Close();
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      std::cerr << "WaveformLibrary::Open: Could not open " << filename
+                << ".\n";
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        size_t(st.st_size) < sizeof(WaveformLibraryHeader)) {
+      close(fd);
+      return false;
+    }
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return false;
+    m_base = p;
+    m_size = st.st_size;
+    m_header = static_cast<const WaveformLibraryHeader*>(p);
+    const auto* bytes = static_cast<const char*>(p);
+    m_data = reinterpret_cast<const float*>(bytes +
+                                            sizeof(WaveformLibraryHeader));
+    m_index = reinterpret_cast<const WaveformLibraryEntry*>(
+        bytes + m_header->indexOffset);
+    if (!Validate()) {
+      std::cerr << "WaveformLibrary::Open: " << filename
+                << " is not a valid waveform library.\n";
+      Close();
+      return false;
+    }
+    madvise(p, m_size, MADV_RANDOM);
+    std::cout << "WaveformLibrary::Open: " << m_header->nWaveforms
+              << " waveforms of " << m_header->nbins << " x "
+              << m_header->tstep << " ns.\n";
+    return true;
+  }
+
+  void Close() {
+    if (m_base) munmap(m_base, m_size);
+    m_base = nullptr;
+    m_size = 0;
+    m_header = nullptr;
+    m_data = nullptr;
+    m_index = nullptr;
+  }
+
+  bool IsOpen() const { return m_header != nullptr; }
+  size_t GetNumberOfWaveforms() const {
+    return m_header ? m_header->nWaveforms : 0;
+  }
+  /// Time of the first bin, relative to the track time [ns].
+  double GetStartTime() const { return m_header ? m_header->tmin : 0.; }
+  double GetTimeStep() const { return m_header ? m_header->tstep : 0.; }
+  unsigned int GetNumberOfBins() const {
+    return m_header ? m_header->nbins : 0;
+  }
+
+  /// Add waveform i, delayed by shift bins, to signal[0..nbins).
+  void Add(const size_t i, const long shift, double* signal,
+           const unsigned int nbins, const double scale = 1.) const {
+    const auto& e = m_index[i];
+    const float* w = m_data + e.offset;
+    const long first = std::max<long>(0, long(e.first) + shift);
+    const long last = std::min<long>(nbins, long(e.first) + e.length + shift);
+    const long k0 = long(e.first) + shift;
+    for (long k = first; k < last; ++k) signal[k] += scale * w[k - k0];
+  }
+
+ private:
+  void* m_base = nullptr;
+  size_t m_size = 0;
+  const WaveformLibraryHeader* m_header = nullptr;
+  const float* m_data = nullptr;
+  const WaveformLibraryEntry* m_index = nullptr;
+
+  /// Check the header and that every waveform lies within the data
+  /// region, so that Add never reads outside the mapping.
+  bool Validate() const {
+    const auto& h = *m_header;
+    if (std::memcmp(h.magic, waveformLibraryMagic, 8) != 0) return false;
+    // The index starts after the data, aligned for in-place use.
+    const size_t dataStart = sizeof(WaveformLibraryHeader);
+    if (h.indexOffset < dataStart || h.indexOffset > m_size ||
+        h.indexOffset % alignof(WaveformLibraryEntry) != 0) {
+      return false;
+    }
+    if (h.nWaveforms >
+        (m_size - h.indexOffset) / sizeof(WaveformLibraryEntry)) {
+      return false;
+    }
+    const uint64_t nData = (h.indexOffset - dataStart) / sizeof(float);
+    for (uint64_t i = 0; i < h.nWaveforms; ++i) {
+      const auto& e = m_index[i];
+      if (e.offset > nData || e.length > nData - e.offset) return false;
+      if (uint64_t(e.first) + e.length > h.nbins) return false;
+    }
+    return true;
+  }
+};
+
+/// Superimposes randomly timed background tracks from a waveform library
+/// on the signal of an event. The number of tracks is Poisson distributed
+/// with the rate per cell times the time range in which a track can
+/// contribute to the window.
+class PileUpOverlay {
+ public:
+  explicit PileUpOverlay(const WaveformLibrary* library = nullptr)
+      : m_library(library) {}
+  void SetLibrary(const WaveformLibrary* library) { m_library = library; }
+  /// Rate of background tracks per cell [MHz].
+  void SetRate(const double rate) { m_rate = rate; }
+
+  /// Add the background to signal[0..nbins) with bins of width tstep
+  /// starting at tmin. Returns the number of overlaid tracks.
+  unsigned int Overlay(double* signal, const double tmin, const double tstep,
+                       const unsigned int nbins) const {
+    if (!m_library || !m_library->IsOpen() || m_rate <= 0.) return 0;
+    const size_t nLib = m_library->GetNumberOfWaveforms();
+    if (nLib == 0) return 0;
+    if (std::abs(m_library->GetTimeStep() - tstep) > 1.e-6 * tstep) {
+      std::cerr << "PileUpOverlay::Overlay: Library time step differs.\n";
+      return 0;
+    }
+    if (m_library->GetNumberOfBins() != nbins) {
+      std::cerr << "PileUpOverlay::Overlay: Library number of bins "
+                << "differs.\n";
+      return 0;
+    }
+    // Tracks up to one library waveform length before the window.
+    const double length = m_library->GetNumberOfBins() * tstep;
+    const double t0 = tmin - length;
+    const double range = length + nbins * tstep;
+    const int n = Garfield::RndmPoisson(m_rate * 1.e-3 * range);
+    for (int k = 0; k < n; ++k) {
+      const size_t i =
+          std::min<size_t>(Garfield::RndmUniform() * nLib, nLib - 1);
+      const double t = t0 + Garfield::RndmUniform() * range;
+      const double tw = t + m_library->GetStartTime();
+      const long shift = std::lround((tw - tmin) / tstep);
+      m_library->Add(i, shift, signal, nbins);
+    }
+    return n;
+  }
+
+ private:
+  const WaveformLibrary* m_library = nullptr;
+  double m_rate = 0.;
+};
+
+}  // namespace IdeaDch
+
+#endif
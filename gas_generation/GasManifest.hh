@@ -0,0 +1,235 @@
+#ifndef GAS_GENERATION_GAS_MANIFEST_HH
+#define GAS_GENERATION_GAS_MANIFEST_HH
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace GasGeneration {
+
+/// A two-component gas mixture at one pressure and temperature, with the
+/// field grid and the statistics of its Magboltz table.
+struct GasMixture {
+  std::string gas1 = "he";
+  double fraction1 = 90.;  // [%], the second gas makes up the rest
+  std::string gas2 = "ic4h10";
+  double pressure = 760.;       // [Torr]
+  double temperature = 293.15;  // [K]
+  double emin = 100.;           // [V/cm]
+  double emax = 100000.;
+  unsigned int nE = 15;
+  bool logE = true;
+  double bmax = 0.;  // [T]
+  unsigned int nB = 1;
+  unsigned int nAngle = 1;
+  int ncoll = 8;  // [10^7 collisions]
+
+  double Fraction2() const { return 100. - fraction1; }
+
+  /// Gas file name, e.g. he_90_ic4h10_10_760torr_293K.gas.
+  std::string FileName() const {
+    char name[256];
+    std::snprintf(name, sizeof(name), "%s_%g_%s_%g_%gtorr_%gK", gas1.c_str(),
+                  fraction1, gas2.c_str(), Fraction2(), pressure,
+                  std::round(temperature));
+    std::string s = name;
+    if (bmax > 0.) s += "_" + Format(bmax) + "T";
+    return s + ".gas";
+  }
+
+  /// Electric field values, spaced as MediumMagboltz::SetFieldGrid does.
+  std::vector<double> Fields() const {
+    std::vector<double> e(nE, emin);
+    for (unsigned int i = 1; i < nE; ++i) {
+      const double f = double(i) / (nE - 1);
+      e[i] = logE ? emin * std::pow(emax / emin, f) : emin + f * (emax - emin);
+    }
+    return e;
+  }
+  std::vector<double> MagneticFields() const {
+    std::vector<double> b(nB, 0.);
+    for (unsigned int i = 1; i < nB; ++i) b[i] = bmax * i / (nB - 1);
+    return b;
+  }
+  /// E-B angles [rad], from 0 to pi / 2 (pi / 2 only if B = 0).
+  std::vector<double> Angles() const {
+    if (nAngle < 2 || bmax <= 0.) return {0.5 * M_PI};
+    std::vector<double> a(nAngle);
+    for (unsigned int i = 0; i < nAngle; ++i) {
+      a[i] = 0.5 * M_PI * i / (nAngle - 1);
+    }
+    return a;
+  }
+
+  static std::string Format(const double x) {
+    char s[32];
+    std::snprintf(s, sizeof(s), "%g", x);
+    return s;
+  }
+};
+
+/// Read a manifest of gas mixtures. Lines are "key = value" with comments
+/// starting with '#'. Each "[mixture]" section inherits the settings of
+/// the previous one; settings before the first section are defaults.
+/// fraction1, pressure and temperature take comma-separated lists, and a
+/// section stands for all combinations of its lists. Two mixtures with
+/// the same gas file name (e.g. differing only in the field grid) are an
+/// error, since one table would overwrite the other.
+inline bool readGasManifest(const std::string& filename,
+                            std::vector<GasMixture>& mixtures) {
+  std::ifstream infile(filename);
+  if (!infile) {
+    std::cerr << "Could not open " << filename << ".\n";
+    return false;
+  }
+  GasMixture mix;
+  std::vector<double> fractions = {mix.fraction1};
+  std::vector<double> pressures = {mix.pressure};
+  std::vector<double> temperatures = {mix.temperature};
+  bool inSection = false;
+  auto expand = [&]() {
+    for (const double f : fractions) {
+      for (const double p : pressures) {
+        for (const double t : temperatures) {
+          GasMixture m = mix;
+          m.fraction1 = f;
+          m.pressure = p;
+          m.temperature = t;
+          mixtures.push_back(m);
+        }
+      }
+    }
+  };
+  auto list = [](const std::string& value, std::vector<double>& v) {
+    v.clear();
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ',')) v.push_back(std::stod(item));
+    return !v.empty();
+  };
+  std::string line;
+  unsigned int lineNumber = 0;
+  while (std::getline(infile, line)) {
+    ++lineNumber;
+    line = line.substr(0, line.find('#'));
+    if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+    if (line.find("[mixture]") != std::string::npos) {
+      if (inSection) expand();
+      inSection = true;
+      continue;
+    }
+    const auto eq = line.find('=');
+    std::string key = line.substr(0, eq), value;
+    key.erase(std::remove_if(key.begin(), key.end(), ::isspace), key.end());
+    if (eq != std::string::npos) {
+      value = line.substr(eq + 1);
+      value.erase(std::remove_if(value.begin(), value.end(), ::isspace),
+                  value.end());
+    }
+    bool ok = eq != std::string::npos && !value.empty();
+    try {
+      if (!ok) {
+        // Not a "key = value" line.
+      } else if (key == "gas1") {
+        mix.gas1 = value;
+      } else if (key == "gas2") {
+        mix.gas2 = value;
+      } else if (key == "fraction1") {
+        ok = list(value, fractions);
+      } else if (key == "pressure") {
+        ok = list(value, pressures);
+      } else if (key == "temperature") {
+        ok = list(value, temperatures);
+      } else if (key == "emin") {
+        mix.emin = std::stod(value);
+      } else if (key == "emax") {
+        mix.emax = std::stod(value);
+      } else if (key == "nE") {
+        mix.nE = std::stoul(value);
+      } else if (key == "logE") {
+        mix.logE = value == "1" || value == "true";
+      } else if (key == "bmax") {
+        mix.bmax = std::stod(value);
+      } else if (key == "nB") {
+        mix.nB = std::stoul(value);
+      } else if (key == "nAngle") {
+        mix.nAngle = std::stoul(value);
+      } else if (key == "ncoll") {
+        mix.ncoll = std::stoi(value);
+      } else {
+        ok = false;
+      }
+    } catch (...) {
+      ok = false;
+    }
+    if (!ok) {
+      std::cerr << filename << ":" << lineNumber << ": cannot parse \""
+                << line << "\".\n";
+      return false;
+    }
+  }
+  if (inSection || mixtures.empty()) expand();
+  for (size_t i = 0; i < mixtures.size(); ++i) {
+    for (size_t j = 0; j < i; ++j) {
+      if (mixtures[i].FileName() != mixtures[j].FileName()) continue;
+      std::cerr << filename << ": " << mixtures[i].FileName()
+                << " is made by more than one mixture.\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Expected CPU time of a field point, interpolated in log E from the
+/// timing records of an earlier table (the .timing.csv written by
+/// generate_he_ic4h10) and scaled with the number of collisions and of
+/// B and angle values. Without records, all points cost the same.
+class CostModel {
+ public:
+  bool Load(const std::string& csv, const int ncoll) {
+    std::ifstream infile(csv);
+    if (!infile) return false;
+    std::string line;
+    std::getline(infile, line);
+    m_le.clear();
+    m_cost.clear();
+    while (std::getline(infile, line)) {
+      double v[16];
+      std::stringstream ss(line);
+      std::string item;
+      int n = 0;
+      while (n < 16 && std::getline(ss, item, ',')) v[n++] = std::stod(item);
+      if (n < 16 || v[0] <= 0.) continue;
+      m_le.push_back(std::log(v[0]));
+      m_cost.push_back(std::max(v[15], 1.e-3) / ncoll);
+    }
+    return m_le.size() > 1;
+  }
+
+  /// Relative cost of all B and angle values at field e.
+  double Cost(const double e, const GasMixture& mix) const {
+    const double n = double(mix.ncoll) * mix.nB * mix.Angles().size();
+    if (m_le.empty()) return n;
+    const double le = std::log(e);
+    if (le <= m_le.front()) return n * m_cost.front();
+    if (le >= m_le.back()) return n * m_cost.back();
+    const size_t i =
+        std::upper_bound(m_le.begin(), m_le.end(), le) - m_le.begin() - 1;
+    const double f = (le - m_le[i]) / (m_le[i + 1] - m_le[i]);
+    return n * (m_cost[i] + f * (m_cost[i + 1] - m_cost[i]));
+  }
+
+ private:
+  std::vector<double> m_le;
+  std::vector<double> m_cost;  // per 10^7 collisions
+};
+
+}  // namespace GasGeneration
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef GAS_GENERATION_GAS_TABLE_MERGE_HH
+#define GAS_GENERATION_GAS_TABLE_MERGE_HH
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Garfield/MediumMagboltz.hh"
+
+namespace GasGeneration {
+
+/// A partial gas table and the statistics its points were computed with
+/// (e.g. the number of collisions in units of 10^7).
+struct GasTablePart {
+  std::string file;
+  double statistics = 0.;
+};
+
+namespace detail {
+
+inline bool same(const double a, const double b) {
+  return std::abs(a - b) <= 1.e-6 * std::max({std::abs(a), std::abs(b), 1.e-12});
+}
+
+/// Sorted union of two grids; returns the number of values of b already in a.
+inline size_t unite(std::vector<double>& a, const std::vector<double>& b) {
+  size_t common = 0;
+  for (const double x : b) {
+    if (std::any_of(a.begin(), a.end(), [x](double y) { return same(x, y); })) {
+      ++common;
+    } else {
+      a.push_back(x);
+    }
+  }
+  std::sort(a.begin(), a.end());
+  return common;
+}
+
+inline bool equal(const std::vector<double>& a, const std::vector<double>& b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (!same(a[i], b[i])) return false;
+  }
+  return true;
+}
+
+}  // namespace detail
+
+/// Combine partial tables of one mixture, pressure and temperature into a
+/// single gas file. The parts must have the same composition, pressure and
+/// temperature, and each must share two of the three grids (E, B, angle)
+/// with the union of the parts merged before it, as MediumGas::MergeGasFile
+/// requires. The grid is sorted; a point present in several parts is taken
+/// from the part with the highest statistics (the last one given among
+/// equals).
+inline bool mergeGasTables(std::vector<GasTablePart> parts,
+                           const std::string& output) {
+  if (parts.empty()) {
+    std::cerr << "mergeGasTables: No input tables.\n";
+    return false;
+  }
+  // Parts with higher statistics are merged later and replace the
+  // values of points which already exist.
+  std::stable_sort(parts.begin(), parts.end(),
+                   [](const GasTablePart& a, const GasTablePart& b) {
+                     return a.statistics < b.statistics;
+                   });
+  Garfield::MediumMagboltz gas;
+  if (!gas.LoadGasFile(parts.front().file)) {
+    std::cerr << "mergeGasTables: Could not load " << parts.front().file
+              << ".\n";
+    return false;
+  }
+  std::vector<double> efields, bfields, angles;
+  gas.GetFieldGrid(efields, bfields, angles);
+  const unsigned int nComponents = gas.GetNumberOfComponents();
+  size_t nReplaced = 0;
+  for (size_t k = 1; k < parts.size(); ++k) {
+    const auto& part = parts[k];
+    Garfield::MediumMagboltz other;
+    if (!other.LoadGasFile(part.file)) {
+      std::cerr << "mergeGasTables: Could not load " << part.file << ".\n";
+      return false;
+    }
+    // Same mixture and conditions.
+    bool compatible = other.GetNumberOfComponents() == nComponents &&
+                      detail::same(other.GetPressure(), gas.GetPressure()) &&
+                      detail::same(other.GetTemperature(),
+                                   gas.GetTemperature());
+    for (unsigned int i = 0; compatible && i < nComponents; ++i) {
+      std::string name0, name1;
+      double f0 = 0., f1 = 0.;
+      gas.GetComponent(i, name0, f0);
+      other.GetComponent(i, name1, f1);
+      compatible = name0 == name1 && detail::same(f0, f1);
+    }
+    if (!compatible) {
+      std::cerr << "mergeGasTables: " << part.file << " is not the same "
+                << "mixture at the same pressure and temperature as "
+                << parts.front().file << ".\n";
+      return false;
+    }
+    // Grids: two of them must be those of the merged table.
+    std::vector<double> e, b, a;
+    other.GetFieldGrid(e, b, a);
+    auto e1 = efields, b1 = bfields, a1 = angles;
+    const size_t commonE = detail::unite(e1, e);
+    const size_t commonB = detail::unite(b1, b);
+    const size_t commonA = detail::unite(a1, a);
+    const bool sameE = detail::equal(e1, efields) && commonE == e.size() &&
+                       e.size() == efields.size();
+    const bool sameB = detail::equal(b1, bfields) && commonB == b.size() &&
+                       b.size() == bfields.size();
+    const bool sameA = detail::equal(a1, angles) && commonA == a.size() &&
+                       a.size() == angles.size();
+    if (sameE + sameB + sameA < 2) {
+      std::cerr << "mergeGasTables: The grid of " << part.file << " does not "
+                << "extend the merged grid along a single axis.\n";
+      return false;
+    }
+    nReplaced += commonE * commonB * commonA;
+    if (!gas.MergeGasFile(part.file, true)) {
+      std::cerr << "mergeGasTables: Could not merge " << part.file << ".\n";
+      return false;
+    }
+    efields = e1;
+    bfields = b1;
+    angles = a1;
+  }
+  if (!gas.WriteGasFile(output)) {
+    std::cerr << "mergeGasTables: Could not write " << output << ".\n";
+    return false;
+  }
+  std::cout << "mergeGasTables: " << parts.size() << " table(s), "
+            << efields.size() << " E x " << bfields.size() << " B x "
+            << angles.size() << " angle points, " << nReplaced
+            << " duplicate point(s) resolved, written to " << output << ".\n";
+  return true;
+}
+
+}  // namespace GasGeneration
+
+#endif
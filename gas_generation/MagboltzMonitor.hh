@@ -0,0 +1,247 @@
+#ifndef GAS_GENERATION_MAGBOLTZ_MONITOR_HH
+#define GAS_GENERATION_MAGBOLTZ_MONITOR_HH
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace GasGeneration {
+
+/// Results and cost of one Magboltz field point.
+struct MagboltzPoint {
+  double e = 0., b = 0., angle = 0.;  // [V/cm], [T], [rad]
+  double velocity = 0., velocityError = 0.;        // [cm/ns], [%]
+  double longDiffusion = 0., longDiffusionError = 0.;  // [cm1/2], [%]
+  double tranDiffusion = 0., tranDiffusionError = 0.;  // [cm1/2], [%]
+  double townsend = 0., townsendError = 0.;        // [1/cm], [%]
+  double attachment = 0., attachmentError = 0.;    // [1/cm], [%]
+  double collisionTime = 0.;                       // [ps]
+  double wallTime = 0., cpuTime = 0.;              // [s]
+};
+
+/// Captures the output of GenerateGasTable while it runs. Standard output
+/// (Garfield's C++ report and the Fortran report of Magboltz) is
+/// redirected into a pipe; a reader thread copies it to a log file,
+/// extracts one record per field point and prints a progress line with an
+/// ETA to stderr.
+class MagboltzMonitor {
+ public:
+  /// Start capturing; nPoints is the number of field points of the grid.
+  bool Start(const std::string& logFile, const size_t nPoints) {
+    m_log.open(logFile);
+    if (!m_log) {
+      std::cerr << "MagboltzMonitor::Start: Could not open " << logFile
+                << ".\n";
+      return false;
+    }
+    m_nPoints = nPoints;
+    m_points.clear();
+    m_nCollisionTimes = 0;
+    std::cout.flush();
+    std::fflush(stdout);
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    m_stdout = dup(STDOUT_FILENO);
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[1]);
+    m_pipe = fds[0];
+    // Line-buffer the C stream (and std::cout, which writes through it)
+    // so that the markers of the field points arrive when they are made.
+    std::setvbuf(stdout, nullptr, _IOLBF, 0);
+    m_start = Clock::now();
+    m_reader = std::thread(&MagboltzMonitor::Read, this);
+    return true;
+  }
+
+  /// Restore standard output and close the last point.
+  void Stop() {
+    if (m_stdout < 0) return;
+    std::cout.flush();
+    std::fflush(stdout);
+    dup2(m_stdout, STDOUT_FILENO);
+    close(m_stdout);
+    m_stdout = -1;
+    m_reader.join();
+    m_log.close();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FinishPoint(Clock::now(), CpuTime());
+    std::cerr << "\n";
+  }
+
+  const std::vector<MagboltzPoint>& GetPoints() const { return m_points; }
+
+  /// Per-point results and timing; the total at the end.
+  void PrintTable(std::ostream& out) const {
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "%10s %5s %6s %10s %6s %9s %6s %9s %6s %11s %9s %9s %9s\n",
+                  "E [V/cm]", "B [T]", "angle", "v [cm/us]", "+-%",
+                  "DL", "+-%", "DT", "+-%", "alpha[1/cm]", "tcoll[ps]",
+                  "wall [s]", "CPU [s]");
+    out << line;
+    double wall = 0., cpu = 0.;
+    for (const auto& p : m_points) {
+      std::snprintf(line, sizeof(line),
+                    "%10.1f %5.2f %6.3f %10.4f %6.2f %9.5f %6.2f %9.5f %6.2f "
+                    "%11.4g %9.2f %9.1f %9.1f\n",
+                    p.e, p.b, p.angle, 1.e3 * p.velocity, p.velocityError,
+                    p.longDiffusion, p.longDiffusionError, p.tranDiffusion,
+                    p.tranDiffusionError, p.townsend, p.collisionTime,
+                    p.wallTime, p.cpuTime);
+      out << line;
+      wall += p.wallTime;
+      cpu += p.cpuTime;
+    }
+    out << "Total: " << m_points.size() << " points, " << wall << " s wall, "
+        << cpu << " s CPU\n";
+  }
+
+  /// The records as CSV, for budgeting further tables.
+  bool WriteCsv(const std::string& filename) const {
+    std::ofstream out(filename);
+    if (!out) return false;
+    out << "e,b,angle,velocity,velocity_err,dl,dl_err,dt,dt_err,townsend,"
+        << "townsend_err,attachment,attachment_err,collision_time,wall_time,"
+        << "cpu_time\n";
+    for (const auto& p : m_points) {
+      out << p.e << "," << p.b << "," << p.angle << "," << p.velocity << ","
+          << p.velocityError << "," << p.longDiffusion << ","
+          << p.longDiffusionError << "," << p.tranDiffusion << ","
+          << p.tranDiffusionError << "," << p.townsend << ","
+          << p.townsendError << "," << p.attachment << ","
+          << p.attachmentError << "," << p.collisionTime << ","
+          << p.wallTime << "," << p.cpuTime << "\n";
+    }
+    return bool(out);
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  std::ofstream m_log;
+  size_t m_nPoints = 0;
+  int m_stdout = -1;
+  int m_pipe = -1;
+  std::thread m_reader;
+  std::mutex m_mutex;
+  std::vector<MagboltzPoint> m_points;
+  // Magboltz's Fortran output may lag behind, so collision times are
+  // assigned to the points in order of appearance.
+  size_t m_nCollisionTimes = 0;
+  Clock::time_point m_start, m_pointStart;
+  double m_pointCpu = 0.;
+  bool m_open = false;
+
+  static double CpuTime() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           1.e-6 * (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+  }
+
+  void Read() {
+    // Returns at end of file, i.e. once Stop has restored stdout.
+    FILE* in = fdopen(m_pipe, "r");
+    if (!in) return;
+    char buffer[4096];
+    std::string line;
+    while (std::fgets(buffer, sizeof(buffer), in)) {
+      line += buffer;
+      if (line.back() != '\n') continue;
+      m_log << line;
+      std::lock_guard<std::mutex> lock(m_mutex);
+      Parse(line);
+      line.clear();
+    }
+    std::fclose(in);
+  }
+
+  /// Value and relative error of a "name: value unit +/- error%" line.
+  static bool Value(const std::string& line, const char* name, double& value,
+                    double& error) {
+    const auto pos = line.find(name);
+    if (pos == std::string::npos) return false;
+    const char* rest = line.c_str() + pos + std::string(name).size();
+    return std::sscanf(rest, " %lf %*s +/- %lf", &value, &error) == 2;
+  }
+
+  void Parse(const std::string& line) {
+    MagboltzPoint p;
+    if (std::sscanf(line.c_str(),
+                    "MediumMagboltz::GenerateGasTable: E = %lf V/cm, B = %lf "
+                    "T, angle: %lf rad",
+                    &p.e, &p.b, &p.angle) == 3) {
+      const auto now = Clock::now();
+      const double cpu = CpuTime();
+      FinishPoint(now, cpu);
+      m_points.push_back(p);
+      m_pointStart = now;
+      m_pointCpu = cpu;
+      m_open = true;
+      Progress(now);
+      return;
+    }
+    double t = 0.;
+    if (std::sscanf(line.c_str(), " CALCULATED MAX. COLLISION TIME = %lf",
+                    &t) == 1) {
+      if (m_nCollisionTimes < m_points.size()) {
+        m_points[m_nCollisionTimes].collisionTime = t;
+      }
+      ++m_nCollisionTimes;
+      return;
+    }
+    if (m_points.empty()) return;
+    auto& q = m_points.back();
+    Value(line, "Drift velocity along E:", q.velocity, q.velocityError) ||
+        Value(line, "Longitudinal diffusion:", q.longDiffusion,
+              q.longDiffusionError) ||
+        Value(line, "Transverse diffusion:", q.tranDiffusion,
+              q.tranDiffusionError) ||
+        Value(line, "Townsend coefficient:", q.townsend, q.townsendError) ||
+        Value(line, "Attachment coefficient:", q.attachment,
+              q.attachmentError);
+  }
+
+  void FinishPoint(const Clock::time_point now, const double cpu) {
+    if (!m_open) return;
+    auto& p = m_points.back();
+    p.wallTime = std::chrono::duration<double>(now - m_pointStart).count();
+    p.cpuTime = cpu - m_pointCpu;
+    m_open = false;
+  }
+
+  /// Progress line on stderr, with the ETA from the mean time per point.
+  void Progress(const Clock::time_point now) const {
+    const size_t done = m_points.size() - 1;
+    const double elapsed =
+        std::chrono::duration<double>(now - m_start).count();
+    std::fprintf(stderr, "\r  point %zu/%zu  E = %.4g V/cm  elapsed %s",
+                 done + 1, m_nPoints, m_points.back().e,
+                 Format(elapsed).c_str());
+    if (done > 0 && m_nPoints > done) {
+      const double eta = elapsed / done * (m_nPoints - done);
+      std::fprintf(stderr, "  ETA %s   ", Format(eta).c_str());
+    }
+    std::fflush(stderr);
+  }
+
+  static std::string Format(const double seconds) {
+    const long s = static_cast<long>(seconds);
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%ld:%02ld:%02ld", s / 3600,
+                  (s / 60) % 60, s % 60);
+    return buffer;
+  }
+};
+
+}  // namespace GasGeneration
+
+#endif